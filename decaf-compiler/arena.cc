@@ -0,0 +1,96 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of the compilation arena.
+ */
+
+#include "arena.h"
+#include "utility.h"
+#include <stdlib.h>
+#include <string.h>
+
+thread_local Arena *Arena::active = NULL;
+
+Arena::Arena() {
+    blocks = NULL;
+    cur = end = NULL;
+    numAllocs = bytesAllocated = bytesReserved = 0;
+    numBlocks = 0;
+}
+
+Arena *Arena::Activate() {
+    Arena *prev = active;
+    active = this;
+    return prev;
+}
+
+/* Arena::AllocSlow
+ * ----------------
+ * Called when the current block cannot satisfy a request. Large requests
+ * get a block of their own so we don't throw away the rest of the current
+ * block; anything else starts a fresh block. The block header is padded so
+ * the payload stays aligned.
+ */
+void *Arena::AllocSlow(size_t size) {
+    bool dedicated = size > BlockSize / 4;
+    size_t payload = dedicated ? size : BlockSize;
+    char *p = NewBlock(payload);
+    if (!dedicated) {
+        cur = p + size;
+        end = p + payload;
+    }
+    return p;
+}
+
+/* Arena::NewBlock
+ * ---------------
+ * Mallocs a block with room for payload bytes, links it in and returns
+ * where the payload starts.
+ */
+char *Arena::NewBlock(size_t payload) {
+    size_t header = (sizeof(Block) + Align - 1) & ~(Align - 1);
+    Block *b = (Block *)malloc(header + payload);
+    if (b == NULL)
+        Failure("Out of memory allocating %lu byte arena block", (unsigned long)(header + payload));
+    b->size = header + payload;
+    b->next = blocks;
+    blocks = b;
+    numBlocks++;
+    bytesReserved += b->size;
+    return (char *)b + header;
+}
+
+/* Arena::Reserve
+ * ---------------
+ * The block is never smaller than an ordinary one. What is left of the
+ * current block is given up, as AllocSlow does.
+ */
+void Arena::Reserve(size_t size) {
+    size = (size + Align - 1) & ~(Align - 1);
+    if (size <= (size_t)(end - cur))
+        return;
+    size_t payload = size > BlockSize ? size : BlockSize;
+    cur = NewBlock(payload);
+    end = cur + payload;
+}
+
+void Arena::Release() {
+    while (blocks) {
+        Block *next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    cur = end = NULL;
+    if (active == this)
+        active = NULL;
+}
+
+char *ArenaStrndup(const char *s, size_t len) {
+    char *copy = (char *)ArenaAlloc(len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *ArenaStrdup(const char *s) {
+    return ArenaStrndup(s, strlen(s));
+}
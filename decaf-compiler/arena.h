@@ -0,0 +1,127 @@
+/* File: arena.h
+ * -------------
+ * A simple bump (arena) allocator for everything that lives exactly as
+ * long as one compilation: ast nodes, lists and their storage, source
+ * locations and string payloads. Memory is carved out of large blocks
+ * one object after another and is never freed piecemeal; the whole
+ * arena is handed back in one shot by Release() when we are done.
+ *
+ * At most one arena is "active" at a time on each thread (each running
+ * compilation activates its own, see compilation.h). Node and List
+ * route their operator new through ArenaAlloc() below, which uses the
+ * active arena if there is one and falls back to the ordinary heap
+ * otherwise (the "noarena" debug key runs a compilation that way).
+ *
+ * Sample usage:
+ *
+ *       Arena arena;
+ *       arena.Activate();
+ *       ... parse and check, every new Node comes from the arena ...
+ *       arena.Release();
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+#include <new>
+
+class Arena
+{
+  private:
+    struct Block {
+        Block *next;
+        size_t size;
+    };
+
+    static const size_t BlockSize = 64 * 1024;
+
+    Block *blocks;
+    char *cur, *end;
+
+    // counters, reported with -d arena
+    size_t numAllocs, bytesAllocated, bytesReserved;
+    int numBlocks;
+
+    static thread_local Arena *active;
+
+    void *AllocSlow(size_t size);
+    char *NewBlock(size_t payload);
+
+  public:
+    Arena();
+    ~Arena() { Release(); }
+
+          // Makes this the arena used by ArenaAlloc(), and returns
+          // the previously active arena (or NULL).
+    Arena *Activate();
+    void Deactivate(Arena *prev = NULL) { active = prev; }
+    static Arena *Active() { return active; }
+
+          // Returns size bytes, aligned for any ordinary object.
+    void *Alloc(size_t size)
+        { size = (size + Align - 1) & ~(Align - 1);
+          numAllocs++; bytesAllocated += size;
+          if (size > (size_t)(end - cur)) return AllocSlow(size);
+          void *p = cur; cur += size; return p; }
+
+          // Makes sure the next size bytes allocated come from one block,
+          // starting a block that big if the current one has less room,
+          // for a caller that knows about how much it is going to need
+          // (see HandParse).
+    void Reserve(size_t size);
+
+          // Frees every block at once. Anything allocated from the
+          // arena is invalid afterwards.
+    void Release();
+
+    size_t NumAllocs() const      { return numAllocs; }
+    size_t BytesAllocated() const { return bytesAllocated; }
+    size_t BytesReserved() const  { return bytesReserved; }
+    int NumBlocks() const         { return numBlocks; }
+
+    static const size_t Align = sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double);
+};
+
+
+/* Functions: ArenaAlloc, ArenaStrdup, ArenaStrndup
+ * ------------------------------------------------
+ * Allocate from the active arena, or from the heap if no arena is
+ * active. Memory obtained here must never be passed to free/delete.
+ */
+inline void *ArenaAlloc(size_t size)
+{
+    Arena *a = Arena::Active();
+    return a ? a->Alloc(size) : ::operator new(size);
+}
+
+char *ArenaStrdup(const char *s);
+char *ArenaStrndup(const char *s, size_t len);
+
+
+/* Class: ArenaAllocator
+ * ---------------------
+ * Standard library allocator adapter so STL containers used inside
+ * ast nodes (e.g. the deque inside List) take their storage from the
+ * arena that was active when the container was created. Deallocation
+ * is a no-op for arena memory.
+ */
+template <class T> class ArenaAllocator
+{
+  public:
+    typedef T value_type;
+    Arena *arena;
+
+    ArenaAllocator() : arena(Arena::Active()) {}
+    template <class U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n)
+        { return (T*)(arena ? arena->Alloc(n * sizeof(T)) : ::operator new(n * sizeof(T))); }
+    void deallocate(T *p, size_t n)
+        { if (!arena) ::operator delete(p); }
+
+    template <class U> bool operator==(const ArenaAllocator<U> &o) const { return arena == o.arena; }
+    template <class U> bool operator!=(const ArenaAllocator<U> &o) const { return arena != o.arena; }
+};
+
+#endif
@@ -5,18 +5,19 @@
 #include "ast.h"
 #include "ast_type.h"
 #include "ast_decl.h"
-#include <string.h> // strdup
 #include <stdio.h>  // printf
 
 class EnvVector;
 
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    location = loc;
+    kind = NK_Node;
     parent = NULL;
 }
 
 Node::Node() {
-    location = NULL;
+    location.first = location.last = NoPos;
+    kind = NK_Node;
     parent = NULL;
 }
 
@@ -24,7 +25,28 @@ void Node::SetEnv(EnvVector *env) {
     this->env=env;
 }
 	 
+/* Node::Print
+ * -----------
+ * Prints the location (or nothing, for a node without one), then the
+ * label and name of the node, indented, and then its children one
+ * level further in.
+ */
+void Node::Print(int indentLevel, const char *label) {
+    const int numSpaces = 3;
+    char span[32] = "";
+    if (location.first != NoPos)
+        snprintf(span, sizeof(span), "%u-%u", location.first, location.last);
+    printf("\n%13s%*s%s%s: ", span, indentLevel*numSpaces, "",
+           label ? label : "", GetPrintNameForNode());
+    PrintChildren(indentLevel);
+}
+
 Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+    kind = NK_Identifier;
+    name = n;
 } 
 
+void Identifier::PrintChildren(int indentLevel) {
+    printf("%s", name);
+}
+
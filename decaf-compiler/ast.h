@@ -6,10 +6,11 @@
  * more correctly, of instances of concrete subclassses such as VarDecl,
  * ForStmt, and AssignExpr).
  * 
- * Location: Each node maintains its lexical location (line and columns in 
- * file), that location can be NULL for those nodes that don't care/use 
- * locations. The location is typcially set by the node constructor.  The 
- * location is used to provide the context when reporting semantic errors.
+ * Location: Each node maintains its lexical location (the span of source
+ * it came from, see location.h), that location can be NULL for those nodes
+ * that don't care/use locations. The location is stored inline in the node
+ * and is typcially set by the node constructor.  The location is used to
+ * provide the context when reporting semantic errors.
  *
  * Parent: Each node has a pointer to its parent. For a Program node, the 
  * parent is NULL, for all other nodes it is the pointer to the node one level
@@ -19,6 +20,22 @@
  * set up links in both directions. The parent link is typically not used 
  * during parsing, but is more important in later phases.
  *
+ * Kind: Each node also carries a small tag naming its concrete class,
+ * set by the constructor. The isa<>, cast<> and dyn_cast<> templates
+ * below test it instead of going through RTTI, e.g.
+ *
+ *       if (FnDecl *fn = dyn_cast<FnDecl>(decl)) ...
+ *
+ * Abstract classes (Decl, Stmt, Expr, ...) own a contiguous range of
+ * kinds, so testing for one of them is a range check.
+ *
+ * Printing: Print() writes the node and everything under it, one node a
+ * line, indented by depth, each with its location (as offsets, like -d
+ * tokens) and kind. Subclasses supply their name and children through
+ * GetPrintNameForNode() and PrintChildren(). With the "ast" debug key on,
+ * the parser prints the whole tree this way, so the trees two parsers
+ * build can be compared.
+ *
  * Semantic analysis: For pp3 you are adding "Check" behavior to the ast
  * node classes. Your semantic analyzer should do an inorder walk on the
  * parse tree, and when visiting each node, verify the particular
@@ -31,15 +48,56 @@
 
 #include <stdlib.h>   // for NULL
 #include "location.h"
+#include "arena.h"
+#include "utility.h"  // for Assert()
 //#include "env_vector.h"
 #include <iostream>
 
 class EnvVector;
 
+// Keep each abstract class's kinds together between its First/Last
+// markers, the classof() tests in the node classes depend on it.
+typedef enum {
+    NK_Node, NK_Identifier, NK_Error, NK_Operator, NK_Program,
+
+    NK_FirstDecl,
+      NK_VarDecl = NK_FirstDecl, NK_ClassDecl, NK_InterfaceDecl, NK_FnDecl,
+    NK_LastDecl = NK_FnDecl,
+
+    NK_FirstType,
+      NK_Type = NK_FirstType, NK_NamedType, NK_ArrayType,
+    NK_LastType = NK_ArrayType,
+
+    NK_FirstStmt,
+      NK_StmtBlock = NK_FirstStmt,
+      NK_FirstConditional,
+        NK_IfStmt = NK_FirstConditional,
+        NK_FirstLoop,
+          NK_ForStmt = NK_FirstLoop, NK_WhileStmt,
+        NK_LastLoop = NK_WhileStmt,
+      NK_LastConditional = NK_LastLoop,
+      NK_BreakStmt, NK_ReturnStmt, NK_PrintStmt,
+      NK_FirstExpr,
+        NK_EmptyExpr = NK_FirstExpr, NK_IntConstant, NK_DoubleConstant,
+        NK_BoolConstant, NK_StringConstant, NK_NullConstant,
+        NK_FirstCompound,
+          NK_ArithmeticExpr = NK_FirstCompound, NK_RelationalExpr,
+          NK_EqualityExpr, NK_LogicalExpr, NK_AssignExpr,
+        NK_LastCompound = NK_AssignExpr,
+        NK_This,
+        NK_FirstLValue,
+          NK_ArrayAccess = NK_FirstLValue, NK_FieldAccess,
+        NK_LastLValue = NK_FieldAccess,
+        NK_Call, NK_NewExpr, NK_NewArrayExpr, NK_ReadIntegerExpr, NK_ReadLineExpr,
+      NK_LastExpr = NK_ReadLineExpr,
+    NK_LastStmt = NK_LastExpr
+} NodeKind;
+
 class Node 
 {
   protected:
-    yyltype *location;
+    yyltype location;
+    NodeKind kind;
     Node *parent;
     EnvVector *env;
 
@@ -48,24 +106,45 @@ class Node
     Node();
     virtual ~Node() {}
 
+    // Nodes are never deleted individually, they all go away when the
+    // compilation arena is released.
+    static void *operator new(size_t size) { return ArenaAlloc(size); }
+    static void operator delete(void *p) {}
+
     void SetEnv(EnvVector *env);
     EnvVector *GetEnv() { return env; }
     
-    yyltype *GetLocation()   { return location; }
+    NodeKind GetKind() const { return kind; }
+    static bool classof(const Node *n) { return true; }
+
+    yyltype *GetLocation()   { return location.first == NoPos ? NULL : &location; }
     void SetParent(Node *p)  { parent = p; }
     Node *GetParent()        { return parent; }
+
+    virtual const char *GetPrintNameForNode() = 0;
+
+    // Print() is deliberately _not_ virtual
+    // subclasses should override PrintChildren() instead
+    void Print(int indentLevel, const char *label = NULL);
+    virtual void PrintChildren(int indentLevel) {}
 };
    
 
+// The name of an Identifier is always interned (see intern.h), so two
+// identifiers name the same thing exactly when their names are the
+// same pointer.
 class Identifier : public Node 
 {
   protected:
-    char *name;
+    const char *name;
     
   public:
-    Identifier(yyltype loc, const char *name);
+    Identifier(yyltype loc, const char *internedName);
+    static bool classof(const Node *n) { return n->GetKind() == NK_Identifier; }
     friend std::ostream& operator<<(std::ostream& out, Identifier *id) { return out << id->name; }
-    char* getName() { return name; }
+    const char* getName() { return name; }
+    const char *GetPrintNameForNode()   { return "Identifier"; }
+    void PrintChildren(int indentLevel);
 };
 
 
@@ -77,9 +156,28 @@ class Identifier : public Node
 class Error : public Node
 {
   public:
-    Error() : Node() {}
+    Error() : Node() { kind = NK_Error; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_Error; }
+    const char *GetPrintNameForNode()   { return "Error"; }
 };
 
 
 
+/* Function templates: isa, cast, dyn_cast
+ * ---------------------------------------
+ * Checked downcasts between node classes, by kind tag. Like dynamic_cast
+ * they accept NULL: isa<> of NULL is false and dyn_cast<> of NULL is
+ * NULL. cast<> asserts the node really is a To and is for when the
+ * caller already knows.
+ */
+template <class To> inline bool isa(const Node *n)
+{ return n != NULL && To::classof(n); }
+
+template <class To> inline To *cast(Node *n)
+{ Assert(n == NULL || isa<To>(n)); return static_cast<To*>(n); }
+
+template <class To> inline To *dyn_cast(Node *n)
+{ return isa<To>(n) ? static_cast<To*>(n) : NULL; }
+
+
 #endif
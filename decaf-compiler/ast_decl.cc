@@ -7,27 +7,32 @@
 #include "ast_type.h"
 #include "ast_stmt.h"
 #include "errors.h"
+#include "compilation.h"
+#include <mutex>
         
          
 Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     Assert(n != NULL);
     (id=n)->SetParent(this); 
     env = NULL;
+    slot = -1;
 }
 
 const char* Decl::getName() {
     return id->getName();
 }
 
-bool VarDecl::MatchesOther(VarDecl *other) {
-    return this->type->IsEquivalentTo(other->type);
-}
-
 VarDecl::VarDecl(Identifier *n, Type *t) : Decl(n) {
+    kind = NK_VarDecl;
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
     shadowtype = t;
 }
+
+void VarDecl::PrintChildren(int indentLevel) {
+    type->Print(indentLevel+1);
+    id->Print(indentLevel+1);
+}
   
 void VarDecl::Check() {
     type->Check();
@@ -46,6 +51,7 @@ void VarDecl::CheckTypes() {
 
 
 ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType*> *imp, List<Decl*> *m) : Decl(n) {
+    kind = NK_ClassDecl;
     // extends can be NULL, impl & mem may be empty lists but cannot be NULL
     Assert(n != NULL && imp != NULL && m != NULL);     
     extends = ex;
@@ -53,47 +59,19 @@ ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType*> *imp, List<D
     (implements=imp)->SetParentAll(this);
     (members=m)->SetParentAll(this);
     checked = false;
+    superclass = NULL;
+    depth = -1;
+    numFields = numMethods = 0;
+    subclasses = nextSubclass = NULL;
+    order = -1;
+    spans = NULL;
 }
 
-void ClassDecl::CheckExtends() {
-
-    if (extends == NULL)
-        return;
-
-    if (!env->TypeExists(extends->getID())) {
-        ReportError::IdentifierNotDeclared(extends->getID(), LookingForClass);
-        env->AddType(new ClassDecl(extends->getID(), NULL, new List<NamedType*>, new List<Decl*>));
-    }
-    
-    ClassDecl *e = dynamic_cast<ClassDecl*>(env->Search(extends->getName()));
-    if (e == NULL) {
-        return;
-    }
-        
-    e->CheckInheritance();
-    EnvVector *parentScope = e->GetEnv();
-    env->SetParent(parentScope);
-
-    for (int i = 0; i < members->NumElements(); i++) {
-        Decl* n = members->Nth(i);
-        Decl* d = parentScope->SearchInScope(n);
-        if (d == NULL)
-            continue;
-        //else
-        // matched name
-        if (dynamic_cast<VarDecl*>(n)) {
-            // no variable redecls
-            ReportError::DeclConflict(n, d);
-        } else if (FnDecl* dfn = dynamic_cast<FnDecl*>(d)) {
-            // is a function too!
-            FnDecl* nfn = dynamic_cast<FnDecl*>(n);
-            if(!nfn->MatchesOther(dfn)) {
-                ReportError::OverrideMismatch(nfn);
-            } 
-        } else {
-            ReportError::DeclConflict(n, d);
-        }
-    } 
+void ClassDecl::PrintChildren(int indentLevel) {
+    id->Print(indentLevel+1);
+    if (extends) extends->Print(indentLevel+1, "(extends) ");
+    implements->PrintAll(indentLevel+1, "(implements) ");
+    members->PrintAll(indentLevel+1);
 }
 
 void ClassDecl::BuildInterface() {
@@ -103,7 +81,7 @@ void ClassDecl::BuildInterface() {
             ReportError::IdentifierNotDeclared(implements->Nth(i)->getID(), LookingForInterface);
             //env->AddType(new InterfaceDecl(implements->Nth(i)->getID(), new List<Decl*>));
         } else {    
-            InterfaceDecl *impl = dynamic_cast<InterfaceDecl*>(env->Search(implements->Nth(i)->getName()));
+            InterfaceDecl *impl = dyn_cast<InterfaceDecl>(env->Search(implements->Nth(i)->getName()));
             if (impl) {
                 impl->Check();
                 impl->AddMethodsToScope(env);
@@ -112,13 +90,37 @@ void ClassDecl::BuildInterface() {
     }
 }
 
+/* Function: CheckInheritance
+ * --------------------------
+ * Builds the class scope, with the superclass's scope as its parent,
+ * checks the members against the superclass's, and adds the class to
+ * the type hierarchy. The superclass has to be done first, and its
+ * superclass before it, and so on up the chain, so each class is
+ * started on the way up the chain (up to one already started) and
+ * finished on the way back down. That is the order recursing would do
+ * them in, and so the order their errors come out in, but the chain is
+ * kept in a list instead of on the C stack, however long it is.
+ */
 void ClassDecl::CheckInheritance() {
-    if (checked)
-        return;
+    List<ClassDecl*> chain;
+    for (ClassDecl *c = this; c != NULL && !c->checked; c = c->StartInheritance())
+        chain.Append(c);
+    for (int i = chain.NumElements() - 1; i >= 0; i--)
+        chain.Nth(i)->FinishInheritance();
+}
+
+/* Function: StartInheritance
+ * --------------------------
+ * Builds the class scope from the members and looks up the superclass,
+ * which it returns (NULL if there is none).
+ */
+ClassDecl *ClassDecl::StartInheritance() {
     checked = true;
+    superclass = NULL;
 
     env = parent->GetEnv()->Push();
     env->SetScopeLevel(ClassScope);
+    env->SetClass(this);
 
     // build class scope
     for (int i = 0; i < members->NumElements(); i++) {
@@ -127,33 +129,234 @@ void ClassDecl::CheckInheritance() {
         n->SetEnv(env);
         //n->Check();
     }
+
+    if (extends == NULL)
+        return NULL;
+
+    if (!env->TypeExists(extends->getID())) {
+        ReportError::IdentifierNotDeclared(extends->getID(), LookingForClass);
+        env->AddType(new ClassDecl(extends->getID(), NULL, new List<NamedType*>, new List<Decl*>));
+    }
     
-    // build extends symbol table 
-    // ONLY NEED DIRECT PARENTS SYMBOL TABLE
-    CheckExtends();
+    superclass = dyn_cast<ClassDecl>(env->Search(extends->getName()));
+    return superclass;
+}
+
+/* Function: FinishInheritance
+ * ---------------------------
+ * Once the superclass is done, links the class scope to its scope and
+ * checks the members against its members, then adds the interfaces'
+ * methods and puts the class in the type hierarchy.
+ */
+void ClassDecl::FinishInheritance() {
+    if (superclass != NULL) {
+        // build extends symbol table 
+        // ONLY NEED DIRECT PARENTS SYMBOL TABLE
+        EnvVector *parentScope = superclass->GetEnv();
+        env->SetParent(parentScope);
+
+        for (int i = 0; i < members->NumElements(); i++) {
+            Decl* n = members->Nth(i);
+            Decl* d = parentScope->SearchInScope(n);
+            if (d == NULL)
+                continue;
+            //else
+            // matched name
+            if (isa<VarDecl>(n)) {
+                // no variable redecls
+                ReportError::DeclConflict(n, d);
+            } else if (FnDecl* dfn = dyn_cast<FnDecl>(d)) {
+                // is a function too!
+                FnDecl* nfn = dyn_cast<FnDecl>(n);
+                if(!nfn->MatchesOther(dfn)) {
+                    ReportError::OverrideMismatch(nfn);
+                } 
+            } else {
+                ReportError::DeclConflict(n, d);
+            }
+        } 
+    }
     
+    // a superclass not finished yet is one that goes round to this one
+    if (superclass == NULL)
+        depth = 0;
+    else if (superclass->depth >= 0)
+        depth = superclass->depth + 1;
+
     // build interface methods
     BuildInterface();
 
     // add class to type hierarchy
-    Type::hierarchy->AddClassInheritance(extends, this->GetType(), implements);
+    Type::Hierarchy()->AddClassInheritance(extends, this->GetType(), implements);
+}
+
+/* Function: LayOut
+ * ----------------
+ * A field's slot is its place in the object, after the fields of the
+ * superclasses, and a method's is its place in the vtable: the same as
+ * the method it overrides if there is one, otherwise after those of the
+ * superclasses. The classes are laid out depth first from each one that
+ * has no superclass, keeping a table of the members visible from the
+ * class being laid out: going down into a subclass enters its members
+ * over the inherited ones, and coming back up undoes that from a log,
+ * as the scopes in a function are kept (see env_vector.h). So a class
+ * is laid out once, in time for its own members, however deep it is.
+ * A class whose superclasses go round in a circle is laid out as if it
+ * had none.
+ *
+ * The table is what a class's scope finds for each name when the class
+ * is laid out, and it only changes as the classes are gone through, so
+ * each change is kept, as a span from the place of the next class in
+ * that order (see MemberSpan). FindMember looks up what a name found
+ * in a class by its place, in the spans of the name. That is as much
+ * as a table of every member of every class, its own and inherited,
+ * would say, in space for one entry per member entered or taken back
+ * out, where those tables would take space for every member again in
+ * every class below it. All of them are made here, before any function
+ * body is checked, and never change after, so the threads of -j read
+ * them as they are.
+ */
+static void AddSpan(Hashtable<List<MemberSpan>*> *spans, int start, const char *name, Decl *member) {
+    List<MemberSpan> *list = spans->Lookup(name);
+    if (list == NULL) {
+        list = new List<MemberSpan>;
+        spans->Enter(name, list);
+    }
+    int n = list->NumElements();
+    if (n > 0 && list->Nth(n - 1).start == start)
+        list->RemoveAt(n - 1);  // changed again before any class saw it
+    MemberSpan span = { start, member };
+    list->Append(span);
+}
+
+void ClassDecl::LayOut(List<Decl*> *decls) {
+    List<ClassDecl*> roots;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        ClassDecl *c = dyn_cast<ClassDecl>(decls->Nth(i));
+        if (c == NULL)
+            continue;
+        if (c->superclass && c->depth >= 0) {
+            c->nextSubclass = c->superclass->subclasses;
+            c->superclass->subclasses = c;
+        } else
+            roots.Append(c);
+    }
+
+    Hashtable<Decl*> visible;
+    List<Decl*> log;    // each member entered, then what it covered or NULL
+    Hashtable<List<MemberSpan>*> *spans = new Hashtable<List<MemberSpan>*>;
+    int next = 0;       // the place of the next class laid out
+    for (int i = 0; i < roots.NumElements(); i++) {
+        ClassDecl *root = roots.Nth(i);
+        ClassDecl *c = root;
+        c->order = next++;
+        c->spans = spans;
+        c->LayOutMembers(NULL, &visible, &log);
+        while (c) {
+            if (ClassDecl *sub = c->subclasses) {
+                c->subclasses = sub->nextSubclass;
+                sub->order = next++;
+                sub->spans = spans;
+                sub->LayOutMembers(c, &visible, &log);
+                c = sub;
+                continue;
+            }
+            // done with c and below, take its members back out
+            int n;
+            while ((n = log.NumElements()) > 0 && log.Nth(n - 2)->GetParent() == c) {
+                Decl *member = log.Nth(n - 2), *outer = log.Nth(n - 1);
+                if (outer)
+                    visible.Enter(member->getName(), outer);
+                else
+                    visible.Remove(member->getName(), member);
+                AddSpan(spans, next, member->getName(), outer);
+                log.RemoveAt(n - 1);
+                log.RemoveAt(n - 2);
+            }
+            c = c == root ? NULL : c->superclass;
+        }
+    }
+}
+
+/* Function: LayOutMembers
+ * -----------------------
+ * Gives the class's members their slots, going on from the class above
+ * it (NULL for none), with visible holding the members it inherits,
+ * and then enters its members into visible, logging each.
+ */
+void ClassDecl::LayOutMembers(ClassDecl *above, Hashtable<Decl*> *visible, List<Decl*> *log) {
+    numFields = above ? above->numFields : 0;
+    numMethods = above ? above->numMethods : 0;
+    for (int i = 0; i < members->NumElements(); i++) {
+        Decl *m = members->Nth(i);
+        if (isa<FnDecl>(m)) {
+            Decl *overridden = visible->Lookup(m->getName());
+            m->SetSlot(overridden && isa<FnDecl>(overridden) ? overridden->GetSlot() : numMethods++);
+        } else
+            m->SetSlot(numFields++);
+        PrintDebug("layout", "%s.%s: %s %d", getName(), m->getName(),
+                   isa<FnDecl>(m) ? "method" : "field", m->GetSlot());
+    }
+    for (int i = 0; i < members->NumElements(); i++) {
+        Decl *m = members->Nth(i);
+        if (env->SearchInScope(m) != m)
+            continue;   // lost to an earlier member of the same name
+        log->Append(m);
+        log->Append(visible->Lookup(m->getName()));
+        visible->Enter(m->getName(), m);
+        AddSpan(spans, order, m->getName(), m);
+    }
+}
+
+/* Function: FindMember
+ * --------------------
+ * One probe of the spans (see LayOut) and a binary search of the name's
+ * for the last that starts at or before the class's place, and if the
+ * name is not a member, a search of the global scope, which is the one
+ * outside the topmost superclass's. The distance to a member is how far
+ * up the superclass chain it is.
+ */
+Decl *ClassDecl::FindMember(const char *name, int *distance) {
+    if (depth < 0 || spans == NULL) // not laid out yet, or in a circle: search the scopes
+        return env->Search(name, distance);
+    Decl *d = NULL;
+    if (List<MemberSpan> *list = spans->Lookup(name)) {
+        int lo = 0, hi = list->NumElements();   // the span is before hi, at or after lo
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (list->Nth(mid).start <= order)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo > 0)
+            d = list->Nth(lo - 1).member;
+    }
+    if (d != NULL) {
+        if (distance) *distance = depth - cast<ClassDecl>(d->GetParent())->depth;
+        return d;
+    }
+    d = parent->GetEnv()->Search(name, distance);
+    if (d != NULL && distance) *distance += depth + 1;
+    return d;
 }
 
 void ClassDecl::CheckFunctions() {
 
     for (int i = 0; i < members->NumElements(); i++) {
-        members->Nth(i)->Check();
-        //if (FnDecl* dfn = dynamic_cast<FnDecl*>(members->Nth(i))) {
-        //    dfn->Check();
-        //}
+        CheckFunctionPart(i);
     }
     
 }
 
+void ClassDecl::CheckFunctionPart(int i) {
+    members->Nth(i)->Check();
+}
+
 void ClassDecl::CheckImplements() {
         // build interface methods
     for (int i = 0; i < implements->NumElements(); i++) {
-        InterfaceDecl *impl = dynamic_cast<InterfaceDecl*>(env->Search(implements->Nth(i)->getName()));
+        InterfaceDecl *impl = dyn_cast<InterfaceDecl>(env->Search(implements->Nth(i)->getName()));
         if (impl && !impl->CheckImplements(env)) 
             ReportError::InterfaceNotImplemented(this, implements->Nth(i));
     }
@@ -168,10 +371,17 @@ void ClassDecl::CheckScope(EnvVector *env) {
 }
 
 InterfaceDecl::InterfaceDecl(Identifier *n, List<Decl*> *m) : Decl(n) {
+    kind = NK_InterfaceDecl;
     Assert(n != NULL && m != NULL);
     (members=m)->SetParentAll(this);
+    for (int i = 0; i < members->NumElements(); i++)
+        members->Nth(i)->SetSlot(i);
 }
 
+void InterfaceDecl::PrintChildren(int indentLevel) {
+    id->Print(indentLevel+1);
+    members->PrintAll(indentLevel+1);
+}
 	
 void InterfaceDecl::Check() {
     EnvVector *next = env->Push();
@@ -189,8 +399,8 @@ void InterfaceDecl::CheckScope(EnvVector *env) {
 bool InterfaceDecl::CheckImplements(EnvVector *sub) {
     bool ok = true;
     for (int i = 0; i < members->NumElements(); i++) {
-        FnDecl *match_par = dynamic_cast<FnDecl*>(members->Nth(i));
-        FnDecl *match_sub = dynamic_cast<FnDecl*>(sub->SearchInScope(members->Nth(i)));
+        FnDecl *match_par = dyn_cast<FnDecl>(members->Nth(i));
+        FnDecl *match_sub = dyn_cast<FnDecl>(sub->SearchInScope(members->Nth(i)));
         if (!match_par || !match_sub) {
             // should be for something like, interface has a method and class 
             // has a field with a name conflict
@@ -215,8 +425,8 @@ void InterfaceDecl::CheckInheritance() {
 
 void InterfaceDecl::AddMethodsToScope(EnvVector *sub) {
     for (int i = 0; i < members->NumElements(); i++) {
-        if (FnDecl* d = dynamic_cast<FnDecl*>(sub->SearchInScope(members->Nth(i)))) {
-            if (!d->MatchesOther(dynamic_cast<FnDecl*>(members->Nth(i)))) {
+        if (FnDecl* d = dyn_cast<FnDecl>(sub->SearchInScope(members->Nth(i)))) {
+            if (!d->MatchesOther(cast<FnDecl>(members->Nth(i)))) {
                 ReportError::OverrideMismatch(d);
             }
         }
@@ -225,49 +435,49 @@ void InterfaceDecl::AddMethodsToScope(EnvVector *sub) {
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
+    kind = NK_FnDecl;
     Assert(n != NULL && r!= NULL && d != NULL);
     (returnType=r)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
+    signature = NULL;
 }
 
 void FnDecl::SetFunctionBody(Stmt *b) { 
     (body=b)->SetParent(this);
 }
 
-bool FnDecl::MatchesOther(FnDecl* other) {
-    if (!this->returnType->IsEquivalentTo(other->returnType)) 
-        return false;
-
-    if (this->formals->NumElements() != other->formals->NumElements())
-        return false;
+void FnDecl::PrintChildren(int indentLevel) {
+    returnType->Print(indentLevel+1, "(return type) ");
+    id->Print(indentLevel+1);
+    formals->PrintAll(indentLevel+1, "(formals) ");
+    if (body) body->Print(indentLevel+1, "(body) ");
+}
 
-    for (int i = 0; i < formals->NumElements(); i++) {
-        if(!formals->Nth(i)->MatchesOther(other->formals->Nth(i)))
-            return false;
-        
-    }
-    return true;
+bool FnDecl::MatchesOther(FnDecl* other) {
+    return GetSignature() == other->GetSignature();
 }
 
 void FnDecl::CheckTypes() {
-    env = env->Push();
+    EnvVector *scope = env->PushTransient();
     for (int i = 0; i < formals->NumElements(); i++) {
-        env->InsertIfNotExists(formals->Nth(i));
+        scope->InsertIfNotExists(formals->Nth(i));
         formals->Nth(i)->Check();
     }
+    scope->Pop();
 }
 
 void FnDecl::Check() { 
 
-    env = env->Push();
+    EnvVector *scope = env->PushTransient();
+    scope->SetFunction(this);
     for (int i = 0; i < formals->NumElements(); i++) {
-        env->InsertIfNotExists(formals->Nth(i));
+        scope->InsertIfNotExists(formals->Nth(i));
         formals->Nth(i)->Check();
     }
-    body->SetEnv(env);
-    body->Check();
-
+    body->SetEnv(scope);
+    body->CheckAll();
+    scope->Pop();
 }
 
 void FnDecl::CheckScope(EnvVector *env) {
@@ -276,22 +486,35 @@ void FnDecl::CheckScope(EnvVector *env) {
 }
 
 void FnDecl::CheckFunctions() {
-    body->SetEnv(env);
-    body->Check();
+    // formals were checked (and conflicts reported) by CheckTypes, the
+    // scope is just built again around the body
+    EnvVector *scope = env->PushTransient();
+    scope->SetFunction(this);
+    for (int i = 0; i < formals->NumElements(); i++) {
+        if (!scope->InScope(formals->Nth(i)))
+            scope->Insert(formals->Nth(i));
+    }
+    body->SetEnv(scope);
+    body->CheckAll();
+    scope->Pop();
 }
 
-List<Type*> *FnDecl::GetFormalsTypes() {
-    List<Type*> *ts = new List<Type*>;
-    for (int i = 0; i < formals->NumElements(); i++) {
-        ts->Append(formals->Nth(i)->GetType());
+Signature *FnDecl::GetSignature() {
+    Signature *s = signature.load(std::memory_order_acquire);
+    if (s == NULL) {
+        List<Type*> ts;
+        ts.Reserve(formals->NumElements());
+        for (int i = 0; i < formals->NumElements(); i++)
+            ts.Append(formals->Nth(i)->GetType());
+        signature.store(s = Signature::Get(returnType, ts), std::memory_order_release);
     }
-    return ts;
+    return s;
 }
 
 Type *ClassDecl::GetType() {
-    return new NamedType(id);
+    return Type::Named(getName());
 }
 
 Type *InterfaceDecl::GetType() {
-    return new NamedType(id);
+    return Type::Named(getName());
 }
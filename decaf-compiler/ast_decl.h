@@ -13,11 +13,13 @@
 #ifndef _H_ast_decl
 #define _H_ast_decl
 
+#include <atomic>
 #include "ast.h"
 #include "list.h"
 #include "env_vector.h"
 
 class Type;
+class Signature;
 class NamedType;
 class Identifier;
 class Stmt;
@@ -26,12 +28,18 @@ class Decl : public Node
 {
   protected:
     Identifier *id;
+    int slot;       // a field's place in its object, a method's in the vtable (see
+                    // ClassDecl::LayOut), an interface member's position in it; -1
+                    // if not a member
   
   public:
     Decl(Identifier *name);
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstDecl && n->GetKind() <= NK_LastDecl; }
     friend std::ostream& operator<<(std::ostream& out, Decl *d) { return out << d->id; }
     const char* getName();
     Identifier *getID() { return id; }
+    int GetSlot() { return slot; }
+    void SetSlot(int s) { slot = s; }
     virtual void Check() {;}
     virtual void CheckScope(EnvVector *other) {;}
     virtual void CheckInheritance() {;}
@@ -39,7 +47,16 @@ class Decl : public Node
     virtual void CheckFunctions() {;}
     virtual void CheckTypes() {;}
     virtual Type *GetType() { return NULL; }
-    bool CheckName(Decl* other) { return strcmp(getName(), other->getName()) == 0;}
+
+          // CheckFunctions, in parts that do not depend on each other, so
+          // they can be checked in any order or at once on different
+          // threads (see Program::Check)
+    virtual int NumFunctionParts() { return 0; }
+    virtual void CheckFunctionPart(int i) {;}
+          // Where in the program part i is, NULL if nowhere
+    virtual yyltype *FunctionPartLocation(int i) { return GetLocation(); }
+
+    bool CheckName(Decl* other) { return getName() == other->getName(); }
 };
 
 class VarDecl : public Decl 
@@ -50,10 +67,12 @@ class VarDecl : public Decl
    
   public:
     VarDecl(Identifier *name, Type *type);
+    static bool classof(const Node *n) { return n->GetKind() == NK_VarDecl; }
+    const char *GetPrintNameForNode() { return "VarDecl"; }
+    void PrintChildren(int indentLevel);
     void Check();
     void CheckScope(EnvVector *env);
-    bool MatchesOther(VarDecl *other);
-    
+
     void AssignType(Type *other) { shadowtype = other; }
     Type *GetCurrentType() { return shadowtype; }
 
@@ -64,11 +83,30 @@ class VarDecl : public Decl
     Type *GetType() { return shadowtype; }
 };
 
+/* Struct: MemberSpan
+ * ------------------
+ * What a name finds in the scopes of the classes from a place in the
+ * order they are laid out in on, up to the next span of the name: the
+ * member, or NULL for none (see ClassDecl::LayOut).
+ */
+struct MemberSpan {
+    int start;
+    Decl *member;
+};
+
 class ClassDecl : public Decl 
 {
   private:
     bool checked;
     EnvVector *inheritanceVector;
+    ClassDecl *superclass;      // found by StartInheritance, NULL if none
+    int depth;                  // superclasses above it, -1 if they go round in a circle
+    int numFields, numMethods;  // its own and inherited ones, set by LayOut
+    ClassDecl *subclasses, *nextSubclass;   // used by LayOut
+    int order;                  // its place in the order LayOut goes through the classes
+    Hashtable<List<MemberSpan>*> *spans;    // see LayOut, shared by every class
+
+    void LayOutMembers(ClassDecl *above, Hashtable<Decl*> *visible, List<Decl*> *log);
 
   protected:
     List<Decl*> *members;
@@ -78,6 +116,9 @@ class ClassDecl : public Decl
   public:
     ClassDecl(Identifier *name, NamedType *extends, 
               List<NamedType*> *implements, List<Decl*> *members);
+    static bool classof(const Node *n) { return n->GetKind() == NK_ClassDecl; }
+    const char *GetPrintNameForNode() { return "ClassDecl"; }
+    void PrintChildren(int indentLevel);
     void Check() {;}
     void CheckScope(EnvVector *env);
 
@@ -85,10 +126,23 @@ class ClassDecl : public Decl
     void CheckImplements();
     void CheckFunctions();
     void CheckTypes() {;}
+    int NumFunctionParts() { return members->NumElements(); }
+    void CheckFunctionPart(int i);
+    yyltype *FunctionPartLocation(int i) { return members->Nth(i)->GetLocation(); }
 
-    void CheckExtends();
+    ClassDecl *StartInheritance();
+    void FinishInheritance();
     void BuildInterface();
     Type *GetType();
+
+          // Finds what name refers to in the class's scope, as Search on
+          // the scope would, and sets distance the same way, but with
+          // one probe of a table instead of one per superclass
+    Decl *FindMember(const char *name, int *distance = NULL);
+
+          // Gives the members of the classes among decls their slots,
+          // once inheritance is resolved
+    static void LayOut(List<Decl*> *decls);
 };
 
 class InterfaceDecl : public Decl 
@@ -98,6 +152,9 @@ class InterfaceDecl : public Decl
     
   public:
     InterfaceDecl(Identifier *name, List<Decl*> *members);
+    static bool classof(const Node *n) { return n->GetKind() == NK_InterfaceDecl; }
+    const char *GetPrintNameForNode() { return "InterfaceDecl"; }
+    void PrintChildren(int indentLevel);
     void Check();
     void CheckScope(EnvVector *env);
     bool CheckImplements(EnvVector *sub);
@@ -116,9 +173,13 @@ class FnDecl : public Decl
     List<VarDecl*> *formals;
     Type *returnType;
     Stmt *body;
+    std::atomic<Signature*> signature;  // set on first call to GetSignature()
     
   public:
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
+    static bool classof(const Node *n) { return n->GetKind() == NK_FnDecl; }
+    const char *GetPrintNameForNode() { return "FnDecl"; }
+    void PrintChildren(int indentLevel);
     void SetFunctionBody(Stmt *b);
     void Check();
     void CheckScope(EnvVector *env);
@@ -128,7 +189,9 @@ class FnDecl : public Decl
     void CheckImplements() {;}
     void CheckTypes();
     void CheckFunctions();
-    List<Type*> *GetFormalsTypes();
+    int NumFunctionParts() { return 1; }
+    void CheckFunctionPart(int i) { CheckFunctions(); }
+    Signature *GetSignature();
     Type *GetType() { return returnType; }
 };
 
@@ -5,31 +5,89 @@
 #include "ast_expr.h"
 #include "ast_type.h"
 #include "ast_decl.h"
+#include "intern.h"
+#include "scanner.h" // for GetLineForPos
 #include <string.h>
+#include <stdio.h>
 
 
+/* Function: CheckType
+ * -------------------
+ * Checks the operands before the expression, and theirs before them and
+ * so on down, keeping the expressions it has started on in a list of its
+ * own rather than on the C stack, so that checking does not recurse
+ * however deeply the expression nests. The operands are taken in the
+ * order ComputeType checks them, so the errors come out in the same
+ * order as if it had recursed.
+ */
+Type *Expr::CheckType(EnvVector *env) {
+    if (checkedType)
+        return checkedType;
+
+    struct Started {
+        Expr *expr;
+        int next;           // index of the operand to look at next
+    };
+    List<Started> started;
+    started.Append(Started{this, 0});
+    while (started.NumElements() > 0) {
+        Started &top = *(started.end() - 1);
+        Expr *operand = top.expr->Operand(env, top.next++);
+        if (operand == NULL) {
+            Expr *e = top.expr;
+            started.RemoveAt(started.NumElements() - 1);
+            if (e->checkedType == NULL)
+                e->checkedType = e->ComputeType(env);
+        } else if (operand->checkedType == NULL) {
+            started.Append(Started{operand, 0});
+        }
+    }
+    return checkedType;
+}
+
 
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
+    kind = NK_IntConstant;
     value = val;
 }
+void IntConstant::PrintChildren(int indentLevel) {
+    printf("%d", value);
+}
 
 DoubleConstant::DoubleConstant(yyltype loc, double val) : Expr(loc) {
+    kind = NK_DoubleConstant;
     value = val;
 }
+void DoubleConstant::PrintChildren(int indentLevel) {
+    printf("%g", value);
+}
 
 BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
+    kind = NK_BoolConstant;
     value = val;
 }
+void BoolConstant::PrintChildren(int indentLevel) {
+    printf("%s", value ? "true" : "false");
+}
 
-StringConstant::StringConstant(yyltype loc, const char *val) : Expr(loc) {
+StringConstant::StringConstant(yyltype loc, const char *val, int len) : Expr(loc) {
     Assert(val != NULL);
-    value = strdup(val);
+    kind = NK_StringConstant;
+    value = val;
+    length = len;
+}
+void StringConstant::PrintChildren(int indentLevel) {
+    printf("%.*s", length, value);
 }
 
 Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
     Assert(tok != NULL);
+    kind = NK_Operator;
     strncpy(tokenString, tok, sizeof(tokenString));
 }
+void Operator::PrintChildren(int indentLevel) {
+    printf("%s", tokenString);
+}
 CompoundExpr::CompoundExpr(Expr *l, Operator *o, Expr *r) 
   : Expr(Join(l->GetLocation(), r->GetLocation())) {
     Assert(l != NULL && o != NULL && r != NULL);
@@ -46,11 +104,55 @@ CompoundExpr::CompoundExpr(Operator *o, Expr *r)
     (right=r)->SetParent(this);
 }
 
+Expr *CompoundExpr::Operand(EnvVector *env, int i) {
+    if (left != NULL && i-- == 0)
+        return left;
+    return i == 0 ? right : NULL;
+}
+
+void CompoundExpr::PrintChildren(int indentLevel) {
+    if (left) left->Print(indentLevel+1);
+    op->Print(indentLevel+1);
+    right->Print(indentLevel+1);
+}
+
+/* Function: Bind
+ * --------------
+ * Looks name up starting from scope, records what it resolved to in
+ * binding and returns the declaration found (NULL if none). A class's
+ * own scope, where obj.field and obj.method() are looked up, is
+ * searched through the members' index (see ClassDecl::FindMember).
+ * With the "bindings" debug key on, each resolution is printed as it is
+ * made.
+ */
+static Decl *Bind(NameBinding &binding, Identifier *name, EnvVector *scope) {
+    ClassDecl *cls = scope->GetContext().cls;
+    if (cls != NULL && cls->GetEnv() == scope)
+        binding.decl = cls->FindMember(name->getName(), &binding.distance);
+    else
+        binding.decl = scope->Search(name->getName(), &binding.distance);
+    binding.slot = binding.decl ? binding.decl->GetSlot() : -1;
+    if (IsDebugOn("bindings")) {
+        yyltype *use = name->GetLocation();
+        if (binding.decl == NULL)
+            PrintDebug("bindings", "%s at %d:%d -> unresolved", name->getName(),
+                       GetLineForPos(use->first), GetColumnForPos(use->first));
+        else
+            PrintDebug("bindings", "%s at %d:%d -> %s at %d:%d, distance %d, slot %d",
+                       name->getName(), GetLineForPos(use->first), GetColumnForPos(use->first),
+                       isa<FnDecl>(binding.decl) ? "function" : "variable",
+                       GetLineForPos(binding.decl->GetLocation()->first),
+                       GetColumnForPos(binding.decl->GetLocation()->first),
+                       binding.distance, binding.slot);
+    }
+    return binding.decl;
+}
+
 void ArithmeticExpr::Check() {
     CheckType(env);
 }
 
-Type *ArithmeticExpr::CheckType(EnvVector *env) {
+Type *ArithmeticExpr::ComputeType(EnvVector *env) {
 
     if (left == NULL) {
         Type* r = right->CheckType(env);
@@ -76,7 +178,7 @@ void RelationalExpr::Check() {
     CheckType(env);
 }
 
-Type *RelationalExpr::CheckType(EnvVector *env) {
+Type *RelationalExpr::ComputeType(EnvVector *env) {
     Type *l = left->CheckType(env);
     Type *r = right->CheckType(env);
 
@@ -93,7 +195,7 @@ void EqualityExpr::Check() {
     CheckType(env);
 }
 
-Type *EqualityExpr::CheckType(EnvVector *env) {
+Type *EqualityExpr::ComputeType(EnvVector *env) {
     Type *l = left->CheckType(env);
     Type *r = right->CheckType(env);
 
@@ -110,7 +212,7 @@ void LogicalExpr::Check() {
     CheckType(env);
 }
 
-Type *LogicalExpr::CheckType(EnvVector *env) {
+Type *LogicalExpr::ComputeType(EnvVector *env) {
     if (left == NULL) {
         Type *r = right->CheckType(env);
         if (r->IsConvertableTo(Type::boolType))
@@ -130,16 +232,10 @@ Type *LogicalExpr::CheckType(EnvVector *env) {
 }
 
 void AssignExpr::Check() {
-    Type *result = CheckType(env);
-    FieldAccess *f = dynamic_cast<FieldAccess*>(left);
-    if (f != NULL) {
-        VarDecl *lval = dynamic_cast<VarDecl*>(env->Search(f->GetFieldName()));
-        if (lval)
-            lval->AssignType(result);        
-    }
+    CheckType(env);
 }
 
-Type *AssignExpr::CheckType(EnvVector *env) {
+Type *AssignExpr::ComputeType(EnvVector *env) {
 
     Type *l = left->CheckType(env);
     Type *r = right->CheckType(env);
@@ -160,8 +256,8 @@ void ArrayAccess::Check() {
     CheckType(env);
 }
 
-Type *ArrayAccess::CheckType(EnvVector *env) {
-    ArrayType *b = dynamic_cast<ArrayType*>(base->CheckType(env));
+Type *ArrayAccess::ComputeType(EnvVector *env) {
+    ArrayType *b = dyn_cast<ArrayType>(base->CheckType(env));
     Type *s = subscript->CheckType(env);
 
     Type *r_type = Type::errorType;
@@ -183,7 +279,7 @@ void FieldAccess::Check() {
     CheckType(env);
 }
 
-Type *FieldAccess::CheckType(EnvVector *env) {
+Type *FieldAccess::ComputeType(EnvVector *env) {
 
     Type *btype = Type::errorType;
     if (base != NULL) {
@@ -194,9 +290,9 @@ Type *FieldAccess::CheckType(EnvVector *env) {
     }
 
     if (base == NULL) { // single field access
-        Decl* t = env->Search(field->getName());
+        Decl* t = Bind(binding, field, env);
         if (t){
-            if (dynamic_cast<FnDecl*>(t) != NULL) {
+            if (isa<FnDecl>(t)) {
                 ReportError::IdentifierNotDeclared(field, LookingForVariable);
                 return Type::errorType;
             }
@@ -217,7 +313,7 @@ Type *FieldAccess::CheckType(EnvVector *env) {
     }
 
 
-    Decl *f = newEnv->Search(field->getName());
+    Decl *f = Bind(binding, field, newEnv);
     if ( f == NULL) {
         ReportError::FieldNotFoundInBase(field, btype);
         return Type::errorType;
@@ -235,7 +331,54 @@ void Call::Check() {
     CheckType(env);
 }
 
-Type *Call::CheckType(EnvVector *env) {
+bool Call::IsArrayLength(Type *baseType) {
+    static const char *length = Intern("length");
+    return isa<ArrayType>(baseType) && field->getName() == length;
+}
+
+/* Function: ChecksActuals
+ * -----------------------
+ * Whether ComputeType goes on to check the actuals, which it does unless
+ * the base is in error or this is arr.length(). The base must have been
+ * checked already.
+ */
+bool Call::ChecksActuals(EnvVector *env) {
+    if (base == NULL)
+        return true;
+    Type *btype = base->CheckType(env);
+    return !btype->IsEquivalentTo(Type::errorType) && !IsArrayLength(btype);
+}
+
+/* Function: FindCallee
+ * --------------------
+ * Works out the scope to look the function up in and looks it up there,
+ * once, between checking the base and checking the actuals.
+ */
+void Call::FindCallee(EnvVector *env) {
+    if (calleeFound)
+        return;
+    calleeFound = true;
+    Type *btype = base ? base->CheckType(env) : Type::errorType;
+    Decl *c = env->GetTypeDecl(btype->getName());
+    if (c)
+        calleeScope = c->GetEnv();
+    else {
+        calleeScope = EnvVector::GetProperScope(env, base);
+    }
+    if (calleeScope != NULL)
+        Bind(binding, field, calleeScope);
+}
+
+Expr *Call::Operand(EnvVector *env, int i) {
+    if (base != NULL && i-- == 0)
+        return base;
+    if (!ChecksActuals(env))
+        return NULL;
+    FindCallee(env);
+    return i < actuals->NumElements() ? actuals->Nth(i) : NULL;
+}
+
+Type *Call::ComputeType(EnvVector *env) {
 
 
     Type *btype = Type::errorType;
@@ -247,38 +390,31 @@ Type *Call::CheckType(EnvVector *env) {
     }
 
     // special case for arr.length()
-    if (dynamic_cast<ArrayType*>(btype) != NULL &&
-        strcmp(field->getName(), "length") == 0) {
+    if (IsArrayLength(btype)) {
             if (actuals->NumElements() != 0) 
                 ReportError::NumArgsMismatch(field, 0, actuals->NumElements());
             return Type::intType;
     }
 
-    EnvVector *newEnv;
-    Decl *c = env->GetTypeDecl(btype->getName());
-    if (c)
-        newEnv = c->GetEnv();
-    else {
-        newEnv = EnvVector::GetProperScope(env, base);
+    // all the actuals are checked (and report their own errors) before
+    // anything is reported against the function; short argument lists
+    // keep their types in the list's inline storage
+    FindCallee(env);
+    List<Type*> actuals_t;
+    actuals_t.Reserve(actuals->NumElements());
+    for (int i = 0; i < actuals->NumElements(); i++) {
+        actuals_t.Append(actuals->Nth(i)->CheckType(env));
     }
 
-    if (newEnv == NULL) {
-        List<Type*> *actuals_t = new List<Type*>;
-        for (int i = 0; i < actuals->NumElements(); i++) {
-            actuals_t->Append(actuals->Nth(i)->CheckType(env));
-        }
+    if (calleeScope == NULL) {
         ReportError::FieldNotFoundInBase(field, base->CheckType(env));
         return Type::errorType;
         
     }
 
 
-    FnDecl *f = dynamic_cast<FnDecl*>(newEnv->Search(field->getName()));
+    FnDecl *f = dyn_cast<FnDecl>(binding.decl);
     if (f == NULL) {
-        List<Type*> *actuals_t = new List<Type*>;
-        for (int i = 0; i < actuals->NumElements(); i++) {
-            actuals_t->Append(actuals->Nth(i)->CheckType(env));
-        }
         //std::cerr << "is base null? " << (base == NULL) << std::endl;
         if (base == NULL) {
             ReportError::IdentifierNotDeclared(field, LookingForFunction);
@@ -288,23 +424,18 @@ Type *Call::CheckType(EnvVector *env) {
         return Type::errorType;
     } 
 
-    List<Type*> *formals = f->GetFormalsTypes();
-    List<Type*> *actuals_t = new List<Type*>;
-    for (int i = 0; i < actuals->NumElements(); i++) {
-        actuals_t->Append(actuals->Nth(i)->CheckType(env));
-    }
-
-    int n = actuals_t->NumElements();
-    if (actuals_t->NumElements() != formals->NumElements()) {
-        ReportError::NumArgsMismatch(field, formals->NumElements(), actuals->NumElements());
-        if (actuals_t->NumElements() > formals->NumElements())
-            n = formals->NumElements();
+    Signature *sig = f->GetSignature();
+    int n = actuals_t.NumElements();
+    if (n != sig->NumParams()) {
+        ReportError::NumArgsMismatch(field, sig->NumParams(), n);
+        if (n > sig->NumParams())
+            n = sig->NumParams();
     }
 
     for (int i = 0; i < n; i++) {
-        Type *t = actuals_t->Nth(i);
-        if (!t->IsConvertableTo(formals->Nth(i))) {
-            ReportError::ArgMismatch(actuals->Nth(i), i+1, t, formals->Nth(i));
+        Type *t = actuals_t.Nth(i);
+        if (!t->IsConvertableTo(sig->Param(i))) {
+            ReportError::ArgMismatch(actuals->Nth(i), i+1, t, sig->Param(i));
         }
     }
     return f->GetType();
@@ -316,8 +447,8 @@ void NewExpr::Check() {
     CheckType(env);
 }
 
-Type *NewExpr::CheckType(EnvVector *env) {
-    if (env->TypeExists(cType->getID()) && dynamic_cast<ClassDecl*>(env->GetTypeDecl(cType->getID())) != NULL) {
+Type *NewExpr::ComputeType(EnvVector *env) {
+    if (env->TypeExists(cType->getID()) && isa<ClassDecl>(env->GetTypeDecl(cType->getID()))) {
         return cType;
     }
 
@@ -333,27 +464,14 @@ void This::Check() {
     CheckType(env);
 }
 
-Decl *This::GetClass() {
-    Node *t = this;
-    while(t) {
-        ClassDecl *c = dynamic_cast<ClassDecl*>(t);
-        if (c != NULL) {
-            return c;
-        }
-        t = t->GetParent();
-    }
-
-    return NULL;
-}
-
-Type *This::CheckType(EnvVector *env) {
+Type *This::ComputeType(EnvVector *env) {
     if (!env->IsInClassScope()) {
         ReportError::ThisOutsideClassScope(this);
         return Type::errorType;
     }
 
     
-    Decl *class_ = GetClass();
+    Decl *class_ = env->GetContext().cls;
     if (class_) 
         return class_->GetType();
 
@@ -368,52 +486,84 @@ void ReadLineExpr::Check() {
     CheckType(env);
 }
 
-Type *NewArrayExpr::CheckType(EnvVector *env) {
+Type *NewArrayExpr::ComputeType(EnvVector *env) {
     if (!size->CheckType(env)->IsConvertableTo(Type::intType))
         ReportError::NewArraySizeNotInteger(size);
     
-    if (NamedType *t = dynamic_cast<NamedType*>(elemType)) {
+    if (NamedType *t = dyn_cast<NamedType>(elemType)) {
         if (!env->TypeExists(t->getID())) {
             ReportError::IdentifierNotDeclared(t->getID(), LookingForType);
-            return new ArrayType(*location, Type::errorType);    
+            return Type::errorType->ArrayOf();
         }
     }
-    return new ArrayType(*location, elemType);
+    return elemType->ArrayOf();
 }
 
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
+    kind = NK_ArrayAccess;
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
 }
+
+void ArrayAccess::PrintChildren(int indentLevel) {
+    base->Print(indentLevel+1);
+    subscript->Print(indentLevel+1, "(subscript) ");
+}
      
 FieldAccess::FieldAccess(Expr *b, Identifier *f) 
   : LValue(b? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
     Assert(f != NULL); // b can be be NULL (just means no explicit base)
+    kind = NK_FieldAccess;
     base = b; 
     if (base) base->SetParent(this); 
     (field=f)->SetParent(this);
 }
 
+void FieldAccess::PrintChildren(int indentLevel) {
+    if (base) base->Print(indentLevel+1);
+    field->Print(indentLevel+1);
+}
+
 
 Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
     Assert(f != NULL && a != NULL); // b can be be NULL (just means no explicit base)
+    kind = NK_Call;
     base = b;
     if (base) base->SetParent(this);
     (field=f)->SetParent(this);
     (actuals=a)->SetParentAll(this);
+    calleeFound = false;
+    calleeScope = NULL;
+}
+
+void Call::PrintChildren(int indentLevel) {
+    if (base) base->Print(indentLevel+1);
+    field->Print(indentLevel+1);
+    actuals->PrintAll(indentLevel+1, "(actuals) ");
 }
  
 
 NewExpr::NewExpr(yyltype loc, NamedType *c) : Expr(loc) { 
   Assert(c != NULL);
+  kind = NK_NewExpr;
   (cType=c)->SetParent(this);
 }
 
+void NewExpr::PrintChildren(int indentLevel) {
+    cType->Print(indentLevel+1);
+}
+
 
 NewArrayExpr::NewArrayExpr(yyltype loc, Expr *sz, Type *et) : Expr(loc) {
     Assert(sz != NULL && et != NULL);
+    kind = NK_NewArrayExpr;
     (size=sz)->SetParent(this); 
     (elemType=et)->SetParent(this);
 }
 
+void NewArrayExpr::PrintChildren(int indentLevel) {
+    size->Print(indentLevel+1);
+    elemType->Print(indentLevel+1);
+}
+
        
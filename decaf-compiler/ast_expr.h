@@ -21,13 +21,42 @@
 class NamedType; // for new
 //class Type; // for NewArray
 
+/* What a name used in an expression (the field of a FieldAccess or
+ * Call) was resolved to when the expression was checked. Later passes
+ * can read it off the node instead of searching the scopes again. */
+struct NameBinding {
+    Decl *decl;         // NULL if the name has not been (or could not be) resolved
+    int distance;       // how many scopes out from the use decl was found
+    int slot;           // decl's slot as a member (see Decl), -1 if not a member
 
+    NameBinding() : decl(NULL), distance(-1), slot(-1) {}
+};
+
+
+/* Each subclass works out its type in ComputeType, reporting any errors
+ * as it goes. CheckType runs that once per node and hands back the same
+ * type after that, so asking for the type of a subexpression again (as
+ * the error paths do) costs nothing and cannot report anything twice.
+ * Before it does, CheckType works out the types of the operands Operand
+ * lists, without recursing (see ast_expr.cc), so ComputeType finds them
+ * already known however deeply the expression nests. */
 class Expr : public Stmt 
 {
+  protected:
+    Type *checkedType;      // set on first call to CheckType()
+
+    virtual Type *ComputeType(EnvVector *env) { return NULL; }
+
+          // The i-th operand ComputeType checks, in the order it checks
+          // them, or NULL past the last. Asked for in order, each once
+          // the ones before it have been checked.
+    virtual Expr *Operand(EnvVector *env, int i) { return NULL; }
+
   public:
-    Expr(yyltype loc) : Stmt(loc) {}
-    Expr() : Stmt() {}
-    virtual Type *CheckType(EnvVector *env) { return NULL; }
+    Expr(yyltype loc) : Stmt(loc), checkedType(NULL) {}
+    Expr() : Stmt(), checkedType(NULL) {}
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstExpr && n->GetKind() <= NK_LastExpr; }
+    Type *CheckType(EnvVector *env);
 };
 
 /* This node type is used for those places where an expression is optional.
@@ -36,7 +65,10 @@ class Expr : public Stmt
 class EmptyExpr : public Expr
 {
   public:
-    Type *CheckType(EnvVector *env) { return Type::voidType; }
+    EmptyExpr() { kind = NK_EmptyExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_EmptyExpr; }
+    const char *GetPrintNameForNode() { return "Empty"; }
+    Type *ComputeType(EnvVector *env) { return Type::voidType; }
     void Check(EnvVector *env) {;}
     void Check() {;}
 };
@@ -48,9 +80,12 @@ class IntConstant : public Expr
   
   public:
     IntConstant(yyltype loc, int val);
+    static bool classof(const Node *n) { return n->GetKind() == NK_IntConstant; }
+    const char *GetPrintNameForNode() { return "IntConstant"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check() {;}
-    Type *CheckType(EnvVector *env) { return Type::intType; }
+    Type *ComputeType(EnvVector *env) { return Type::intType; }
 };
 
 class DoubleConstant : public Expr 
@@ -60,9 +95,12 @@ class DoubleConstant : public Expr
     
   public:
     DoubleConstant(yyltype loc, double val);
+    static bool classof(const Node *n) { return n->GetKind() == NK_DoubleConstant; }
+    const char *GetPrintNameForNode() { return "DoubleConstant"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check() {;}
-    Type *CheckType(EnvVector *env) { return Type::doubleType; }
+    Type *ComputeType(EnvVector *env) { return Type::doubleType; }
 };
 
 class BoolConstant : public Expr 
@@ -72,30 +110,39 @@ class BoolConstant : public Expr
     
   public:
     BoolConstant(yyltype loc, bool val);
+    static bool classof(const Node *n) { return n->GetKind() == NK_BoolConstant; }
+    const char *GetPrintNameForNode() { return "BoolConstant"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check() {;}
-    Type *CheckType(EnvVector *env) { return Type::boolType; }
+    Type *ComputeType(EnvVector *env) { return Type::boolType; }
 };
 
 class StringConstant : public Expr 
 { 
   protected:
-    char *value;
+    const char *value;      // points into the input, not NUL-terminated
+    int length;
     
   public:
-    StringConstant(yyltype loc, const char *val);
+    StringConstant(yyltype loc, const char *val, int len);
+    static bool classof(const Node *n) { return n->GetKind() == NK_StringConstant; }
+    const char *GetPrintNameForNode() { return "StringConstant"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check() {;}
-    Type *CheckType(EnvVector *env) { return Type::stringType; }
+    Type *ComputeType(EnvVector *env) { return Type::stringType; }
 };
 
 class NullConstant: public Expr 
 {
   public: 
-    NullConstant(yyltype loc) : Expr(loc) {}
+    NullConstant(yyltype loc) : Expr(loc) { kind = NK_NullConstant; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_NullConstant; }
+    const char *GetPrintNameForNode() { return "NullConstant"; }
     void Check(EnvVector *env) {;}
     void Check() {;}
-    Type *CheckType(EnvVector *env) { return Type::nullType; }
+    Type *ComputeType(EnvVector *env) { return Type::nullType; }
 };
 
 class Operator : public Node 
@@ -105,6 +152,9 @@ class Operator : public Node
     
   public:
     Operator(yyltype loc, const char *tok);
+    static bool classof(const Node *n) { return n->GetKind() == NK_Operator; }
+    const char *GetPrintNameForNode() { return "Operator"; }
+    void PrintChildren(int indentLevel);
     friend std::ostream& operator<<(std::ostream& out, Operator *o) { return out << o->tokenString; }
     void Check(EnvVector *env) {;}
  };
@@ -118,73 +168,85 @@ class CompoundExpr : public Expr
   public:
     CompoundExpr(Expr *lhs, Operator *op, Expr *rhs); // for binary
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
-    Type *CheckType(EnvVector *env) { return NULL; }
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstCompound && n->GetKind() <= NK_LastCompound; }
+    void PrintChildren(int indentLevel);
+    Type *ComputeType(EnvVector *env) { return NULL; }
+    Expr *Operand(EnvVector *env, int i);
 };
 
 class ArithmeticExpr : public CompoundExpr 
 {
   public:
-    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
+    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = NK_ArithmeticExpr; }
+    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) { kind = NK_ArithmeticExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_ArithmeticExpr; }
+    const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
 };
 
 class RelationalExpr : public CompoundExpr 
 {
   public:
-    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    Type *CheckType(EnvVector *env);
+    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = NK_RelationalExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_RelationalExpr; }
+    const char *GetPrintNameForNode() { return "RelationalExpr"; }
+    Type *ComputeType(EnvVector *env);
     void Check();
 };
 
 class EqualityExpr : public CompoundExpr 
 {
   public:
-    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = NK_EqualityExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_EqualityExpr; }
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
 };
 
 class LogicalExpr : public CompoundExpr 
 {
   public:
-    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
-    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
+    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = NK_LogicalExpr; }
+    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) { kind = NK_LogicalExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_LogicalExpr; }
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
 };
 
 class AssignExpr : public CompoundExpr 
 {
   public:
-    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
+    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) { kind = NK_AssignExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_AssignExpr; }
     const char *GetPrintNameForNode() { return "AssignExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
 };
 
 class LValue : public Expr 
 {
   public:
     LValue(yyltype loc) : Expr(loc) {}
-    Type *CheckType(EnvVector *env) { return NULL; }
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstLValue && n->GetKind() <= NK_LastLValue; }
+    Type *ComputeType(EnvVector *env) { return NULL; }
 };
 
 class This : public Expr 
 {
   public:
-    This(yyltype loc) : Expr(loc) {}
+    This(yyltype loc) : Expr(loc) { kind = NK_This; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_This; }
+    const char *GetPrintNameForNode() { return "This"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
-    Decl *GetClass();
+    Type *ComputeType(EnvVector *env);
 };
 
 class ArrayAccess : public LValue 
@@ -194,9 +256,13 @@ class ArrayAccess : public LValue
     
   public:
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
+    static bool classof(const Node *n) { return n->GetKind() == NK_ArrayAccess; }
+    const char *GetPrintNameForNode() { return "ArrayAccess"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
+    Expr *Operand(EnvVector *env, int i) { return i == 0 ? base : i == 1 ? subscript : NULL; }
 };
 
 /* Note that field access is used both for qualified names
@@ -209,13 +275,19 @@ class FieldAccess : public LValue
   protected:
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
+    NameBinding binding;
     
   public:
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
+    static bool classof(const Node *n) { return n->GetKind() == NK_FieldAccess; }
+    const char *GetPrintNameForNode() { return "FieldAccess"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
-    char *GetFieldName() { return field->getName(); }
+    Type *ComputeType(EnvVector *env);
+    Expr *Operand(EnvVector *env, int i) { return i == 0 ? base : NULL; }
+    const char *GetFieldName() { return field->getName(); }
+    const NameBinding &GetBinding() { return binding; }
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -228,13 +300,25 @@ class Call : public Expr
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
     List<Expr*> *actuals;
+    NameBinding binding;
+    bool calleeFound;           // FindCallee has set calleeScope and binding
+    EnvVector *calleeScope;     // where the function is looked up, NULL if nowhere
+
+    bool IsArrayLength(Type *baseType);
+    bool ChecksActuals(EnvVector *env);
+    void FindCallee(EnvVector *env);
     
   public:
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
+    static bool classof(const Node *n) { return n->GetKind() == NK_Call; }
+    const char *GetPrintNameForNode() { return "Call"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
+    Expr *Operand(EnvVector *env, int i);
     Expr *GetBase() { return base; }
+    const NameBinding &GetBinding() { return binding; }
 };
 
 class NewExpr : public Expr
@@ -244,9 +328,12 @@ class NewExpr : public Expr
     
   public:
     NewExpr(yyltype loc, NamedType *clsType);
+    static bool classof(const Node *n) { return n->GetKind() == NK_NewExpr; }
+    const char *GetPrintNameForNode() { return "NewExpr"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
 };
 
 class NewArrayExpr : public Expr
@@ -257,27 +344,35 @@ class NewArrayExpr : public Expr
     
   public:
     NewArrayExpr(yyltype loc, Expr *sizeExpr, Type *elemType);
+    static bool classof(const Node *n) { return n->GetKind() == NK_NewArrayExpr; }
+    const char *GetPrintNameForNode() { return "NewArrayExpr"; }
+    void PrintChildren(int indentLevel);
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env);
+    Type *ComputeType(EnvVector *env);
+    Expr *Operand(EnvVector *env, int i) { return i == 0 ? size : NULL; }
 };
 
 class ReadIntegerExpr : public Expr
 {
   public:
-    ReadIntegerExpr(yyltype loc) : Expr(loc) {}
+    ReadIntegerExpr(yyltype loc) : Expr(loc) { kind = NK_ReadIntegerExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_ReadIntegerExpr; }
+    const char *GetPrintNameForNode() { return "ReadIntegerExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env) { return Type::intType; }
+    Type *ComputeType(EnvVector *env) { return Type::intType; }
 };
 
 class ReadLineExpr : public Expr
 {
   public:
-    ReadLineExpr(yyltype loc) : Expr (loc) {}
+    ReadLineExpr(yyltype loc) : Expr (loc) { kind = NK_ReadLineExpr; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_ReadLineExpr; }
+    const char *GetPrintNameForNode() { return "ReadLineExpr"; }
     void Check(EnvVector *env) {;}
     void Check();
-    Type *CheckType(EnvVector *env) { return Type::stringType; }
+    Type *ComputeType(EnvVector *env) { return Type::stringType; }
 };
 
     
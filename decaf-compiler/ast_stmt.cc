@@ -7,13 +7,26 @@
 #include "ast_decl.h"
 #include "ast_expr.h"
 #include "env_vector.h"
+#include "compilation.h"
+#include "inheritance_hierarchy.h"
+#include "scanner.h" // for GetLineForPos
+#include "work_stealing.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
 
 
 Program::Program(List<Decl*> *d) {
     Assert(d != NULL);
+    kind = NK_Program;
     (decls=d)->SetParentAll(this);
 }
 
+void Program::PrintChildren(int indentLevel) {
+    decls->PrintAll(indentLevel+1);
+    printf("\n");
+}
+
 void Program::Check() {
     /* pp3: here is where the semantic analyzer is kicked off.
      *      The general idea is perform a tree traversal of the
@@ -39,6 +52,8 @@ void Program::Check() {
     for (int i = 0; i < decls->NumElements(); i++) {
         decls->Nth(i)->CheckInheritance();
     }
+    Type::Hierarchy()->Freeze();
+    ClassDecl::LayOut(decls);
     
     // check implements
     for (int i = 0; i < decls->NumElements(); i++) {
@@ -46,20 +61,144 @@ void Program::Check() {
     }
 
     // check fn children
+    CheckFunctions();
+}
+
+/* Class: FunctionChecks
+ * ---------------------
+ * The parts of the declarations' CheckFunctions (see ast_decl.h) as the
+ * tasks of a WorkStealing, each printing into an output buffer of its
+ * own. The threads other than the calling one are workers of the
+ * compilation (see compilation.h); the calling one moves to an arena of
+ * its own for the while too.
+ */
+class FunctionChecks : public WorkStealing
+{
+  public:
+    Compilation *comp;
+    std::vector<Decl*> decls;           // task i checks part parts[i]
+    std::vector<int> parts;             // of decls[i]
+    std::vector<OutputBuffer> output;
+    std::vector<std::pair<SourcePos, int> > places;  // of each task, and the task
+    Arena *mainArena;                   // the calling thread's, put back after
+
+  protected:
+    void StartThread(int thread) {
+        if (thread > 0)
+            comp->ActivateWorker();
+        else {
+            Arena *arena = comp->WorkerArena();
+            mainArena = arena ? arena->Activate() : NULL;
+        }
+    }
+    void DoTask(int task, int thread) {
+        OutputBuffer::Install(&output[task]);
+        decls[task]->CheckFunctionPart(parts[task]);
+        OutputBuffer::Install(NULL);
+    }
+    void FinishThread(int thread) {
+        if (thread > 0)
+            comp->Deactivate(NULL);
+        else if (mainArena)
+            Arena::Active()->Deactivate(mainArena);
+    }
+};
+
+struct PlaceOrder {
+    bool operator()(const std::pair<SourcePos, int> &a, const std::pair<SourcePos, int> &b) const
+    { return a.first < b.first; }
+};
+
+/* Function: CheckFunctions
+ * ------------------------
+ * The last phase: checks the bodies of the functions and methods (and
+ * the types of the fields). Everything they are checked against is
+ * built by then, so with -j they are checked on that many threads at
+ * once, and what each function prints is held back. The buffers are
+ * then sorted by where in the program their function is (one that is
+ * nowhere goes after the one before it) and printed in that order,
+ * which is the order they are checked in without -j. So the output is
+ * the same whatever the number of threads. The messages in a buffer
+ * stay in the order they were reported, as they are without -j: a
+ * message about an argument comes before the one about the call, say,
+ * though the call starts first.
+ */
+void Program::CheckFunctions() {
+    Compilation *comp = Compilation::Active();
+    if (comp->options.numJobs <= 1) {
+        for (int i = 0; i < decls->NumElements(); i++) {
+            decls->Nth(i)->CheckFunctions();
+        }
+        return;
+    }
+
+    FunctionChecks checks;
+    checks.comp = comp;
+    SourcePos last = 0;
     for (int i = 0; i < decls->NumElements(); i++) {
-        decls->Nth(i)->CheckFunctions();
+        Decl *d = decls->Nth(i);
+        for (int part = 0; part < d->NumFunctionParts(); part++) {
+            yyltype *loc = d->FunctionPartLocation(part);
+            if (loc)
+                last = loc->first;
+            checks.places.push_back(std::make_pair(last, (int)checks.decls.size()));
+            checks.decls.push_back(d);
+            checks.parts.push_back(part);
+        }
+    }
+    checks.output.resize(checks.decls.size());
+    GetLineForPos(0);   // the line table is built on first use, so before the threads
+    checks.Run(checks.decls.size(), comp->options.numJobs);
+    std::stable_sort(checks.places.begin(), checks.places.end(), PlaceOrder());
+    for (size_t i = 0; i < checks.places.size(); i++)
+        comp->numErrors += checks.output[checks.places[i].second].Flush(*comp->diagnostics);
+}
+
+/* Function: CheckAll
+ * ------------------
+ * Checks the statement and the ones nested in it, and theirs in them
+ * and so on down, keeping the statements it has started on in a list of
+ * its own rather than on the C stack, as Expr::CheckType does for
+ * operands. Each is checked, then its nested ones in turn, then left,
+ * so everything happens in the order it would if Check recursed.
+ */
+void Stmt::CheckAll() {
+    struct Started {
+        Stmt *stmt;
+        int next;           // index of the nested statement to check next
+    };
+    List<Started> started;
+    Check();
+    started.Append(Started{this, 0});
+    while (started.NumElements() > 0) {
+        Started &top = *(started.end() - 1);
+        Stmt *nested = top.stmt->Nested(top.next++);
+        if (nested == NULL) {
+            Stmt *s = top.stmt;
+            started.RemoveAt(started.NumElements() - 1);
+            s->Leave();
+        } else {
+            nested->Check();
+            started.Append(Started{nested, 0});
+        }
     }
 }
 
 StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
     Assert(d != NULL && s != NULL);
+    kind = NK_StmtBlock;
     (decls=d)->SetParentAll(this);
     (stmts=s)->SetParentAll(this);
 }
 
+void StmtBlock::PrintChildren(int indentLevel) {
+    decls->PrintAll(indentLevel+1);
+    stmts->PrintAll(indentLevel+1);
+}
+
 void StmtBlock::Check() {
  
-    env = env->Push();
+    env = env->PushTransient();
 
     //std::cout << "Printing scope at line: " << parent->GetLocation()->first_line << std::endl;
     //env->PrintScope();
@@ -70,12 +209,17 @@ void StmtBlock::Check() {
         decls->Nth(i)->SetEnv(env);
         decls->Nth(i)->Check();
     }
+}
 
-    for (int i = 0; i < stmts->NumElements(); i++) {
-        stmts->Nth(i)->SetEnv(env);
-        stmts->Nth(i)->Check();
-    }
+Stmt *StmtBlock::Nested(int i) {
+    if (i >= stmts->NumElements())
+        return NULL;
+    stmts->Nth(i)->SetEnv(env);
+    return stmts->Nth(i);
+}
 
+void StmtBlock::Leave() {
+    env->Pop();
 }
 
 ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) { 
@@ -84,14 +228,41 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
     (body=b)->SetParent(this);
 }
 
+void ConditionalStmt::PrintChildren(int indentLevel) {
+    test->Print(indentLevel+1, "(test) ");
+    body->Print(indentLevel+1, "(body) ");
+}
+
+// if, while and for all check their test (and for its init and step)
+// in a scope of their own, pushed by Check, and then the body in it
+Stmt *ConditionalStmt::Nested(int i) {
+    if (i > 0)
+        return NULL;
+    body->SetEnv(env);
+    return body;
+}
+
+void ConditionalStmt::Leave() {
+    env->Pop();
+}
+
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
     Assert(i != NULL && t != NULL && s != NULL && b != NULL);
+    kind = NK_ForStmt;
     (init=i)->SetParent(this);
     (step=s)->SetParent(this);
 }
 
+void ForStmt::PrintChildren(int indentLevel) {
+    init->Print(indentLevel+1, "(init) ");
+    test->Print(indentLevel+1, "(test) ");
+    step->Print(indentLevel+1, "(step) ");
+    body->Print(indentLevel+1, "(body) ");
+}
+
 void ForStmt::Check() {
-    env = env->Push();
+    env = env->PushTransient();
+    env->EnterLoop();
     if (init) {
         init->SetEnv(env);
         init->Check();
@@ -103,58 +274,62 @@ void ForStmt::Check() {
         step->SetEnv(env);
         step->Check();
     }
-    body->SetEnv(env);
-    body->Check();
 }
 
 void WhileStmt::Check() {
-    env = env->Push();
+    env = env->PushTransient();
+    env->EnterLoop();
     test->SetEnv(env);
     if (!test->CheckType(env)->IsConvertableTo(Type::boolType))
         ReportError::TestNotBoolean(test);
-    body->SetEnv(env);
-    body->Check();
 }
 
 IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
     Assert(t != NULL && tb != NULL); // else can be NULL
+    kind = NK_IfStmt;
     elseBody = eb;
     if (elseBody) elseBody->SetParent(this);
 }
 
+void IfStmt::PrintChildren(int indentLevel) {
+    test->Print(indentLevel+1, "(test) ");
+    body->Print(indentLevel+1, "(then) ");
+    if (elseBody) elseBody->Print(indentLevel+1, "(else) ");
+}
+
 void IfStmt::Check() {
-    env = env->Push();
+    env = env->PushTransient();
     test->SetEnv(env);
     if (!test->CheckType(env)->IsConvertableTo(Type::boolType))
         ReportError::TestNotBoolean(test);
-    
-    body->SetEnv(env);
-    body->Check();
-    if (elseBody) {
+}
+
+Stmt *IfStmt::Nested(int i) {
+    if (i == 1 && elseBody) {
         elseBody->SetEnv(env);
-        elseBody->Check();
+        return elseBody;
     }
+    return ConditionalStmt::Nested(i);
 }
 
 ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
     Assert(e != NULL);
+    kind = NK_ReturnStmt;
     (expr=e)->SetParent(this);
 }
+
+void ReturnStmt::PrintChildren(int indentLevel) {
+    expr->Print(indentLevel+1);
+}
 void ReturnStmt::Check() {
-    Node *p = parent;
-    while (p) {
-        FnDecl *f = dynamic_cast<FnDecl*>(p);
-        if (f != NULL) {
-            // check return type
-            Type *rtype = expr->CheckType(env); // empty expr needs to return void?
-            Type *ftype = f->GetType();
-            if (!rtype->IsConvertableTo(ftype)) {
-                ReportError::ReturnMismatch(this, rtype, ftype);
-            }
+    const Context &ctx = env->GetContext();
+    if (ctx.fn != NULL) {
+        // check return type
+        Type *rtype = expr->CheckType(env); // empty expr needs to return void?
+        if (!rtype->IsConvertableTo(ctx.returnType)) {
+            ReportError::ReturnMismatch(this, rtype, ctx.returnType);
         }
-        p = p->GetParent();
     }
-   
 }
 
 yyltype *ReturnStmt::GetLocation() {
@@ -163,9 +338,14 @@ yyltype *ReturnStmt::GetLocation() {
   
 PrintStmt::PrintStmt(List<Expr*> *a) {    
     Assert(a != NULL);
+    kind = NK_PrintStmt;
     (args=a)->SetParentAll(this);
 }
 
+void PrintStmt::PrintChildren(int indentLevel) {
+    args->PrintAll(indentLevel+1, "(args) ");
+}
+
 void PrintStmt::Check() {
     for (int i = 0; i < args->NumElements(); i++) {
         Type *t = args->Nth(i)->CheckType(env);
@@ -177,13 +357,6 @@ void PrintStmt::Check() {
 
 
 void BreakStmt::Check() {
-    Node *p = parent;
-    while (p) {
-        if (dynamic_cast<LoopStmt*>(p) != NULL) {
-            return;
-        }
-        p = p->GetParent();
-    }
-
-    ReportError::BreakOutsideLoop(this);
+    if (env->GetContext().loopDepth == 0)
+        ReportError::BreakOutsideLoop(this);
 }
\ No newline at end of file
@@ -27,15 +27,33 @@ class Program : public Node
      
   public:
      Program(List<Decl*> *declList);
+     static bool classof(const Node *n) { return n->GetKind() == NK_Program; }
+     const char *GetPrintNameForNode() { return "Program"; }
+     void PrintChildren(int indentLevel);
      void Check();
+     void CheckFunctions();
 };
 
+/* Check checks the statement itself. A statement with others nested in
+ * it (a block, if, while or for) only does what comes before them
+ * there: the nested ones are listed by Nested, and then Leave finishes
+ * up. CheckAll runs all three for the statement and everything nested
+ * in it, without recursing (see ast_stmt.cc), so checking takes no more
+ * of the C stack however deeply statements nest. */
 class Stmt : public Node
 {
   public:
      Stmt() : Node() {}
      Stmt(yyltype loc) : Node(loc) {}
+     static bool classof(const Node *n) { return n->GetKind() >= NK_FirstStmt && n->GetKind() <= NK_LastStmt; }
      virtual void Check() {;}
+
+          // The i-th statement nested in this one, in the order they are
+          // checked, with its env set, or NULL past the last. Asked for in
+          // order, each once the ones before it have been checked.
+     virtual Stmt *Nested(int i) { return NULL; }
+     virtual void Leave() {}
+     void CheckAll();
 };
 
 class StmtBlock : public Stmt 
@@ -46,7 +64,12 @@ class StmtBlock : public Stmt
     
   public:
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
+    static bool classof(const Node *n) { return n->GetKind() == NK_StmtBlock; }
+    const char *GetPrintNameForNode() { return "StmtBlock"; }
+    void PrintChildren(int indentLevel);
     void Check();
+    Stmt *Nested(int i);
+    void Leave();
 };
 
   
@@ -58,6 +81,10 @@ class ConditionalStmt : public Stmt
   
   public:
     ConditionalStmt(Expr *testExpr, Stmt *body);
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstConditional && n->GetKind() <= NK_LastConditional; }
+    void PrintChildren(int indentLevel);
+    Stmt *Nested(int i);
+    void Leave();
 };
 
 class LoopStmt : public ConditionalStmt 
@@ -65,6 +92,7 @@ class LoopStmt : public ConditionalStmt
   public:
     LoopStmt(Expr *testExpr, Stmt *body)
             : ConditionalStmt(testExpr, body) {}
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstLoop && n->GetKind() <= NK_LastLoop; }
 };
 
 class ForStmt : public LoopStmt 
@@ -74,13 +102,18 @@ class ForStmt : public LoopStmt
   
   public:
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
+    static bool classof(const Node *n) { return n->GetKind() == NK_ForStmt; }
+    const char *GetPrintNameForNode() { return "ForStmt"; }
+    void PrintChildren(int indentLevel);
     void Check();
 };
 
 class WhileStmt : public LoopStmt 
 {
   public:
-    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
+    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) { kind = NK_WhileStmt; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_WhileStmt; }
+    const char *GetPrintNameForNode() { return "WhileStmt"; }
     void Check();
 };
 
@@ -91,13 +124,19 @@ class IfStmt : public ConditionalStmt
   
   public:
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
+    static bool classof(const Node *n) { return n->GetKind() == NK_IfStmt; }
+    const char *GetPrintNameForNode() { return "IfStmt"; }
+    void PrintChildren(int indentLevel);
     void Check();
+    Stmt *Nested(int i);
 };
 
 class BreakStmt : public Stmt 
 {
   public:
-    BreakStmt(yyltype loc) : Stmt(loc) {}
+    BreakStmt(yyltype loc) : Stmt(loc) { kind = NK_BreakStmt; }
+    static bool classof(const Node *n) { return n->GetKind() == NK_BreakStmt; }
+    const char *GetPrintNameForNode() { return "BreakStmt"; }
     void Check();
 };
 
@@ -108,6 +147,9 @@ class ReturnStmt : public Stmt
   
   public:
     ReturnStmt(yyltype loc, Expr *expr);
+    static bool classof(const Node *n) { return n->GetKind() == NK_ReturnStmt; }
+    const char *GetPrintNameForNode() { return "ReturnStmt"; }
+    void PrintChildren(int indentLevel);
     void Check();
 
     yyltype *GetLocation();
@@ -120,6 +162,9 @@ class PrintStmt : public Stmt
     
   public:
     PrintStmt(List<Expr*> *arguments);
+    static bool classof(const Node *n) { return n->GetKind() == NK_PrintStmt; }
+    const char *GetPrintNameForNode() { return "PrintStmt"; }
+    void PrintChildren(int indentLevel);
     void Check();
 };
 
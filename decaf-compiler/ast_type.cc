@@ -5,8 +5,12 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "errors.h"
+#include <stdio.h>
 #include <string.h>
+#include <string>
 #include "inheritance_hierarchy.h"
+#include "intern.h"
+#include "compilation.h"
 
  
 /* Class constants
@@ -14,51 +18,98 @@
  * These are public constants for the built-in base types (int, double, etc.)
  * They can be accessed with the syntax Type::intType. This allows you to
  * directly access them and share the built-in types where needed rather that
- * creates lots of copies.
+ * creates lots of copies. Each compilation makes its own, and activating
+ * it points these at them (see compilation.h).
  */
 
-Type *Type::intType    = new Type("int");
-Type *Type::doubleType = new Type("double");
-Type *Type::voidType   = new Type("void");
-Type *Type::boolType   = new Type("bool");
-Type *Type::nullType   = new Type("null");
-Type *Type::stringType = new Type("string");
-Type *Type::errorType  = new Type("error"); 
+thread_local Type *Type::intType    = NULL;
+thread_local Type *Type::doubleType = NULL;
+thread_local Type *Type::voidType   = NULL;
+thread_local Type *Type::boolType   = NULL;
+thread_local Type *Type::nullType   = NULL;
+thread_local Type *Type::stringType = NULL;
+thread_local Type *Type::errorType  = NULL;
 
 
-InheritanceHierarchy *Type::hierarchy = new InheritanceHierarchy();
+InheritanceHierarchy *Type::Hierarchy() {
+    return Compilation::Active()->hierarchy;
+}
+
+// canonical named and array types do not come from any one place
+static const yyltype nowhere = { NoPos, NoPos };
+
+Hashtable<NamedType*> *Type::NamedTypes() {
+    return Compilation::Active()->namedTypes;
+}
 
 Type::Type(const char *n) {
     Assert(n);
-    typeName = strdup(n);
+    kind = NK_Type;
+    typeName = Intern(n);
+    canonical = this;
+    arrayOf = NULL;
+}
+
+void Type::PrintChildren(int indentLevel) {
+    printf("%s", typeName);
+}
+
+NamedType *Type::Named(const char *name) {
+    Hashtable<NamedType*> *namedTypes = NamedTypes();
+    std::lock_guard<std::mutex> hold(Compilation::Active()->typesLock);
+    NamedType *t = namedTypes->Lookup(name);
+    if (t == NULL) {
+        t = new NamedType(name);
+        namedTypes->Enter(name, t);
+    }
+    return t;
+}
+
+ArrayType *Type::ArrayOf() {
+    Type *elem = Canonical();
+    ArrayType *a = elem->arrayOf.load(std::memory_order_acquire);
+    if (a == NULL) {
+        std::lock_guard<std::mutex> hold(Compilation::Active()->typesLock);
+        a = elem->arrayOf.load(std::memory_order_relaxed);
+        if (a == NULL)
+            elem->arrayOf.store(a = new ArrayType(elem), std::memory_order_release);
+    }
+    return a;
 }
 
 bool Type::IsConvertableTo(Type *other) {
-    if (dynamic_cast<ArrayType*>(other) != NULL)
+    if (isa<ArrayType>(other))
         return false;
 
     return IsEquivalentTo(other) || (IsEquivalentTo(Type::errorType) || other->IsEquivalentTo(Type::errorType))
-    || (IsEquivalentTo(Type::nullType) && dynamic_cast<NamedType*>(other) != NULL);
+    || (IsEquivalentTo(Type::nullType) && isa<NamedType>(other));
 }
 	
 NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
     Assert(i != NULL);
+    kind = NK_NamedType;
     (id=i)->SetParent(this);
+    typeName = id->getName();
 } 
 
+void NamedType::PrintChildren(int indentLevel) {
+    id->Print(indentLevel+1);
+}
+
 bool NamedType::IsConvertableTo(Type *other) {
     // no polymorphism atm
 
     // add flag for interface OK
-    return IsEquivalentTo(other) || Type::hierarchy->IsSubClassOf(other, this) || Type::hierarchy->IsInterfaceOf(other, this);
+    return IsEquivalentTo(other) || Type::Hierarchy()->IsSubClassOf(other, this) || Type::Hierarchy()->IsInterfaceOf(other, this);
 }
 
 bool NamedType::IsInterfaceableTo(Type *other) {
-    return IsEquivalentTo(other) || Type::hierarchy->IsInterfaceOf(other, this);
+    return IsEquivalentTo(other) || Type::Hierarchy()->IsInterfaceOf(other, this);
 }
 
-char* NamedType::getName() {
-    return id->getName();
+NamedType::NamedType(const char *name) : Type(name) {
+    kind = NK_NamedType;
+    (id=new Identifier(nowhere, typeName))->SetParent(this);
 }
 
 Identifier* NamedType::getID() {
@@ -73,17 +124,27 @@ bool NamedType::Check() {
     return true;
 }
 
-bool NamedType::IsEquivalentTo(Type *other) {
-    return strcmp(getName(), other->getName()) == 0;
-}
-
 ArrayType::ArrayType(yyltype loc, Type *et) : Type(loc) {
     Assert(et != NULL);
+    kind = NK_ArrayType;
     (elemType=et)->SetParent(this);
+    typeName = NULL; // getName asks the canonical type
+}
+
+void ArrayType::PrintChildren(int indentLevel) {
+    elemType->Print(indentLevel+1);
+}
+
+ArrayType::ArrayType(Type *elem) : Type(nowhere) {
+    kind = NK_ArrayType;
+    elemType = elem; // shared, so not parented to any one array
+    canonical = this;
+    std::string name = std::string(elem->getName()) + "[]";
+    typeName = Intern(name.c_str(), name.length());
 }
 
 bool ArrayType::IsConvertableTo(Type *other) {
-    ArrayType *o = dynamic_cast<ArrayType*>(other);
+    ArrayType *o = dyn_cast<ArrayType>(other);
     if (o == NULL) {
         return false;
     }
@@ -91,8 +152,36 @@ bool ArrayType::IsConvertableTo(Type *other) {
     return elemType->IsConvertableTo(o->elemType);
 }
 
+Hashtable<Signature*> *Signature::Signatures() {
+    return Compilation::Active()->signatures;
+}
 
-bool ArrayType::IsEquivalentTo(Type *other) {
-    return elemType->IsEquivalentTo(other);
+Signature *Signature::Get(Type *r, const List<Type*> &ps) {
+    std::string name = std::string(r->Canonical()->getName()) + "(";
+    for (int i = 0; i < ps.NumElements(); i++) {
+        if (i > 0) name += ",";
+        name += ps.Nth(i)->Canonical()->getName();
+    }
+    name += ")";
+    const char *key = Intern(name.c_str(), name.length());
+
+    // the types are all canonical already, so making the signature does
+    // not need the lock again
+    Hashtable<Signature*> *signatures = Signatures();
+    std::lock_guard<std::mutex> hold(Compilation::Active()->typesLock);
+    Signature *s = signatures->Lookup(key);
+    if (s == NULL) {
+        s = new Signature(key, r, ps);
+        signatures->Enter(key, s);
+    }
+    return s;
 }
 
+Signature::Signature(const char *k, Type *r, const List<Type*> &ps) {
+    key = k;
+    returnType = r->Canonical();
+    numParams = ps.NumElements();
+    params = (Type **)ArenaAlloc(numParams * sizeof(Type*));
+    for (int i = 0; i < numParams; i++)
+        params[i] = ps.Nth(i)->Canonical();
+}
@@ -7,6 +7,20 @@
  *
  * pp3: You will need to extend the Type classes to implement
  * the type system and rules for type equivalency and compatibility.
+ *
+ * Every distinct type has exactly one canonical Type object: each
+ * built-in type is its own, each class or interface name has one
+ * NamedType, and each canonical type has one array-of type. Type nodes
+ * in the parse tree keep their own locations (for error messages) but
+ * map to the canonical type, so two types are equivalent exactly when
+ * their canonical types are the same pointer.
+ *
+ * Canonical types and signatures are made on first use, and that can be
+ * while function bodies are being checked on several threads (see
+ * Program::Check): the tables of them are only used under the
+ * compilation's typesLock, and the pointers a type caches are atomic.
+ * Two threads may both work out a type's canonical type, but they get
+ * the same one.
  */
  
 #ifndef _H_ast_type
@@ -15,65 +29,131 @@
 #include "ast.h"
 #include "list.h"
 #include "env_vector.h"
+#include "intern.h"
+#include <atomic>
 #include <iostream>
 
 class InheritanceHierarchy;
+class NamedType;
+class ArrayType;
+class Signature;
 
 class Type : public Node 
 {
   
   protected:
-    char *typeName;
+    const char *typeName;
+    std::atomic<Type*> canonical;       // set on first call to Canonical()
+    std::atomic<ArrayType*> arrayOf;    // canonical types only, set by ArrayOf()
+
+    virtual Type *MakeCanonical() { return this; }
+
+    static Hashtable<NamedType*> *NamedTypes();    // of the active compilation
 
   public :
-    static Type *intType, *doubleType, *boolType, *voidType,
-                *nullType, *stringType, *errorType;
+           // The active compilation's built-in types, see Compilation::Activate
+    static thread_local Type *intType, *doubleType, *boolType, *voidType,
+                             *nullType, *stringType, *errorType;
 
-    Type(yyltype loc) : Node(loc) {}
+    Type(yyltype loc) : Node(loc), canonical(NULL), arrayOf(NULL) { kind = NK_Type; }
     Type(const char *str);
+    static bool classof(const Node *n) { return n->GetKind() >= NK_FirstType && n->GetKind() <= NK_LastType; }
+    const char *GetPrintNameForNode() { return "Type"; }
+    void PrintChildren(int indentLevel);
     
     virtual void PrintToStream(std::ostream& out) { out << typeName; }
     friend std::ostream& operator<<(std::ostream& out, Type *t) { t->PrintToStream(out); return out; }
-    bool IsEquivalentTo(Type *other) { return strcmp(getName(), other->getName()) == 0; }
+    bool IsEquivalentTo(Type *other) { return Canonical() == other->Canonical(); }
     virtual bool IsConvertableTo(Type *other);
     virtual bool Check() { return true; }
-    virtual char* getName() { return typeName; }
+    virtual const char* getName() { return typeName; } // interned
+
+    Type *Canonical() {
+        Type *c = canonical.load(std::memory_order_acquire);
+        if (c == NULL)
+            canonical.store(c = MakeCanonical(), std::memory_order_release);
+        return c;
+    }
+    ArrayType *ArrayOf();                       // canonical array of this type
+    static NamedType *Named(const char *name);  // canonical type for a class/interface name
     
-    static InheritanceHierarchy *hierarchy;
+    static InheritanceHierarchy *Hierarchy();   // of the active compilation
 };
 
 class NamedType : public Type 
 {
+  friend class Type;
+
   protected:
     Identifier *id;
-    
+
+    NamedType(const char *name);      // see Type::Named
+    Type *MakeCanonical() { return Named(typeName); }
+
   public:
     NamedType(Identifier *i);
+    static bool classof(const Node *n) { return n->GetKind() == NK_NamedType; }
+    const char *GetPrintNameForNode() { return "NamedType"; }
+    void PrintChildren(int indentLevel);
     
     void PrintToStream(std::ostream& out) { out << id; }
-    char* getName();
     Identifier* getID();  
     bool Check();
-    bool IsEquivalentTo(Type *other);
     bool IsConvertableTo(Type *other);
     bool IsInterfaceableTo(Type *other);
 };
 
 class ArrayType : public Type 
 {
+  friend class Type;
+
   protected:
     Type *elemType;
 
+    ArrayType(Type *canonicalElem);   // see Type::ArrayOf
+    Type *MakeCanonical() { return elemType->ArrayOf(); }
+
   public:
     ArrayType(yyltype loc, Type *elemType);
+    static bool classof(const Node *n) { return n->GetKind() == NK_ArrayType; }
+    const char *GetPrintNameForNode() { return "ArrayType"; }
+    void PrintChildren(int indentLevel);
     
     void PrintToStream(std::ostream& out) { out << elemType << "[]"; }
     bool Check() { return elemType->Check(); }
-    char* getName() { return elemType->getName(); }
-    bool IsEquivalentTo(Type *other);
+    const char* getName() { return static_cast<ArrayType*>(Canonical())->typeName; } // e.g. "int[]"
     bool IsConvertableTo(Type *other);
     Type *GetType() { return elemType; }
 };
 
+/* Signature: the return and parameter types of a function, as canonical
+ * types. Like types, signatures are interned, so two functions have
+ * the same signature exactly when they have the same Signature object.
+ * Each FnDecl asks for its signature once and keeps it.
+ */
+class Signature
+{
+  protected:
+    const char *key;          // interned, e.g. "int(double,A[])"
+    Type *returnType;
+    Type **params;
+    int numParams;
+
+    static Hashtable<Signature*> *Signatures(); // of the active compilation
+
+    Signature(const char *key, Type *returnType, const List<Type*> &params);
+
+  public:
+           // The unique signature with these return and parameter types
+    static Signature *Get(Type *returnType, const List<Type*> &params);
+
+    static void *operator new(size_t size) { return ArenaAlloc(size); }
+    static void operator delete(void *p) {}
+
+    Type *GetReturnType() { return returnType; }
+    int NumParams() { return numParams; }
+    Type *Param(int i) { Assert(i >= 0 && i < numParams); return params[i]; }
+    unsigned Hash() { return InternedHash(key); }
+};
  
 #endif
@@ -0,0 +1,237 @@
+#!/bin/bash
+
+# Times ./dcc on generated inputs that have hurt performance before.
+# Each case is written to a temp file and run at increasing sizes, so
+# anything that grows faster than it should shows up as a jump in the
+# times.
+#
+#   chain N : a call/field chain o.m(o.m(...).f).f nested N deep, where
+#             every level reports an error
+#   hierarchy N: N classes, each extending the one before and implementing
+#             an interface of its own, then a function of N assignments
+#             of the deepest class to the top one and to the first
+#             interface, each a subclass or interface test up the chain
+#   members N: N classes, each extending the one before with a field and
+#             a method of its own, and a method of the last that calls
+#             every method and reads every field through an object of
+#             the last class, each a member lookup up the chain
+#   lex N   : the samples that scan without errors, pasted together N
+#             times and run through just the scanner (-d lexonly), once
+#             with flex and once with the hand-written scanner
+#             (-fhand-scanner); prints throughput in MB/s
+#   idents N: N lines of nothing but identifiers and keywords, scanned
+#             the same way
+#   classes N: N small classes that compile without errors, compiled in
+#             full with each scanner, inline and with -fscan-thread (the
+#             scanner on a thread of its own), and with the hand-written
+#             scanner and -fscan-chunks (split up and scanned on every
+#             core); inputs under 1 MB (2 MB for chunks, or on one core)
+#             are scanned inline either way
+#   parse N : the same N classes, then a function with a syntax error
+#             in it, so that the whole program is parsed but never
+#             checked. Run with the hand-written scanner through just
+#             the scanner (-d lexonly), and then each parser (bison,
+#             and -fhand-parser); the difference is the time to parse
+#   syntax N: the same N classes, compiled in full and with -fsyntax-only
+#             (parsed, no tree built, nothing checked), with each scanner
+#   jobs N  : the same N classes, compiled in full with -j 1, 2, 4 and 8
+#             (function bodies checked on that many threads); the times
+#             only drop as far as there are cores, see the first line
+#
+# Then hashtable_bench times Hashtable itself against the std::multimap
+# table it replaced, with 10, 1000 and 100000 keys: nanoseconds per key
+# entered, and per lookup of a key that is in the table and of one that
+# is not.
+
+#make
+
+TIMEFORMAT=%3R
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+chain() {
+    e="1"
+    for ((k = 0; k < $1; k++))
+    do
+        e="o.m($e).f"
+    done
+    echo "int f;"
+    echo "class A { int f; A m(int x) { return this; } }"
+    echo "void main() { A o; int y; y = $e; }"
+}
+
+run() {
+    file="$tmp/$1-$2.decaf"
+    $1 $2 > "$file"
+    secs=$( { time ./dcc < "$file" > "$tmp/out" 2>&1 ; } 2>&1 )
+    errors=$(grep -c "^\*\*\* Error" "$tmp/out")
+    printf "%-15s %7d: %8s s, %d errors\n" $1 $2 $secs $errors
+}
+
+lex() {
+    clean=$(for f in samples/*/*.decaf
+            do
+                ./dcc "$f" -d lexonly 2>&1 | grep -q "^\*\*\* Error" || echo "$f"
+            done)
+    for ((k = 0; k < $1; k++))
+    do
+        cat $clean
+    done
+}
+
+idents() {
+    awk -v n=$1 'BEGIN { for (k = 0; k < n; k++)
+        print "int count" k " while limit if value this New NewArray ReadLine",
+              "true false elsewhere forward return result_value_" k " break" }'
+}
+
+classes() {
+    awk -v n=$1 'BEGIN {
+        for (k = 0; k < n; k++) {
+            print "class C" k " {"
+            print "    int count; double total; string name;"
+            print "    int Step(int x, double scale) {"
+            print "        int i; double acc;"
+            print "        acc = 0.0;"
+            print "        for (i = 0; i < x; i = i + 1) {"
+            print "            if (i % 2 == 0 && count != 0x1F) acc = acc + scale * 2.0;"
+            print "            else { count = count - 1; Print(\"odd\", i, name); }"
+            print "        }"
+            print "        while (count > 0) { count = count / 2; total = total + acc; }"
+            print "        return count;"
+            print "    }"
+            print "}"
+        }
+        print "void main() { C0 c; c = New(C0); Print(c.Step(10, 1.5)); }" }'
+}
+
+hierarchy() {
+    awk -v n=$1 'BEGIN {
+        for (k = 0; k < n; k++) print "interface I" k " { }"
+        print "class C0 implements I0 { }"
+        for (k = 1; k < n; k++) print "class C" k " extends C" k - 1 " implements I" k " { }"
+        print "void main() { C0 top; I0 first; C" n - 1 " deep;"
+        for (k = 0; k < n; k++) print "    top = deep; first = deep;"
+        print "}" }'
+}
+
+members() {
+    awk -v n=$1 'BEGIN {
+        print "class C0 { int f0; int M0() { return f0; } }"
+        for (k = 1; k < n; k++)
+            print "class C" k " extends C" k - 1 " { int f" k "; int M" k "() { return f" k "; } }"
+        print "class Last extends C" n - 1 " { int Run() { Last o; int x;"
+        for (k = 0; k < n; k++) print "    x = o.M" k "() + o.f" k ";"
+        print "    return x; } }"
+        print "void main() { Last l; l = New(Last); Print(l.Run()); }" }'
+}
+
+lexrun() {
+    file="$tmp/$1-$2.decaf"
+    $1 $2 > "$file"
+    bytes=$(wc -c < "$file")
+    for scanner in flex hand
+    do
+        [ $scanner = flex ] && args="" || args="-fhand-scanner"
+        secs=$( { time ./dcc "$file" $args -d lexonly > /dev/null 2>&1 ; } 2>&1 )
+        printf "%-15s %7d: %8s s, %s\n" $1-$scanner $2 $secs \
+            "$(awk -v b=$bytes -v s=$secs 'BEGIN { printf "%.1f MB/s", (s > 0 ? b / s / 1e6 : 0) }')"
+    done
+}
+
+piperun() {
+    file="$tmp/$1-$2.decaf"
+    $1 $2 > "$file"
+    bytes=$(wc -c < "$file")
+    for args in "" -fscan-thread -fhand-scanner "-fhand-scanner -fscan-thread" \
+        "-fhand-scanner -fscan-chunks"
+    do
+        secs=$( { time ./dcc "$file" $args > /dev/null 2>&1 ; } 2>&1 )
+        printf "%-32s %7d: %8s s, %s\n" "$1${args:+ $args}" $2 $secs \
+            "$(awk -v b=$bytes -v s=$secs 'BEGIN { printf "%.1f MB/s", (s > 0 ? b / s / 1e6 : 0) }')"
+    done
+}
+
+parserun() {
+    file="$tmp/$1-$2.decaf"
+    { classes $2; echo "void unchecked() { ) }"; } > "$file"
+    bytes=$(wc -c < "$file")
+    for args in "-d lexonly" "" -fhand-parser
+    do
+        secs=$( { time ./dcc "$file" -fhand-scanner $args > /dev/null 2>&1 ; } 2>&1 )
+        printf "%-32s %7d: %8s s, %s\n" "$1 -fhand-scanner${args:+ $args}" $2 $secs \
+            "$(awk -v b=$bytes -v s=$secs 'BEGIN { printf "%.1f MB/s", (s > 0 ? b / s / 1e6 : 0) }')"
+    done
+}
+
+syntaxrun() {
+    file="$tmp/$1-$2.decaf"
+    classes $2 > "$file"
+    bytes=$(wc -c < "$file")
+    for args in "" -fhand-scanner -fsyntax-only "-fsyntax-only -fhand-scanner"
+    do
+        secs=$( { time ./dcc "$file" $args > /dev/null 2>&1 ; } 2>&1 )
+        printf "%-32s %7d: %8s s, %s\n" "$1${args:+ $args}" $2 $secs \
+            "$(awk -v b=$bytes -v s=$secs 'BEGIN { printf "%.1f MB/s", (s > 0 ? b / s / 1e6 : 0) }')"
+    done
+}
+
+jobsrun() {
+    file="$tmp/$1-$2.decaf"
+    classes $2 > "$file"
+    bytes=$(wc -c < "$file")
+    for j in 1 2 4 8
+    do
+        secs=$( { time ./dcc "$file" -j $j > /dev/null 2>&1 ; } 2>&1 )
+        printf "%-28s %7d: %8s s, %s\n" "$1 -j $j" $2 $secs \
+            "$(awk -v b=$bytes -v s=$secs 'BEGIN { printf "%.1f MB/s", (s > 0 ? b / s / 1e6 : 0) }')"
+    done
+}
+
+for n in 4 8 12 16 20
+do
+    run chain $n
+done
+
+for n in 1000 2000 4000
+do
+    run hierarchy $n
+done
+
+for n in 4000 8000 16000
+do
+    run members $n
+done
+
+for n in 10 100 1000
+do
+    lexrun lex $n
+done
+
+for n in 10000 100000 1000000
+do
+    lexrun idents $n
+done
+
+for n in 1000 10000 100000
+do
+    piperun classes $n
+done
+
+for n in 1000 10000 100000
+do
+    parserun parse $n
+done
+
+for n in 1000 10000 100000
+do
+    syntaxrun syntax $n
+done
+
+echo "$(nproc) cores"
+for n in 10000 100000
+do
+    jobsrun jobs $n
+done
+
+make -s hashtable_bench && ./hashtable_bench 10 1000 100000
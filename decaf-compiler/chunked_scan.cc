@@ -0,0 +1,160 @@
+/* File: chunked_scan.cc
+ * ---------------------
+ * Implementation of the ChunkedScan, see chunked_scan.h.
+ */
+
+#include <string.h>
+#include "chunked_scan.h"
+#include "compilation.h"
+#include "scanner.h"
+#include "utility.h"
+
+
+/* Function: FindSplits
+ * --------------------
+ * Returns where each of (at most) numChunks chunks of the program
+ * starts, the first at 0. Each chunk after the first starts just after
+ * the first newline outside a comment at or after its even share of the
+ * program. Strings and // comments are skipped so that what looks like
+ * the start of a comment inside them is not taken for one, the same as
+ * the scanners do.
+ */
+static std::vector<size_t> FindSplits(const char *text, size_t length, int numChunks) {
+    std::vector<size_t> splits(1, 0);
+    const char *p = text, *end = text + length;
+    size_t want = length / numChunks;
+    while (p < end && splits.size() < (size_t)numChunks) {
+        switch (*p) {
+          case '\n':
+            p++;
+            if ((size_t)(p - text) >= want && p < end) {
+                splits.push_back(p - text);
+                want = length / numChunks * splits.size();
+            }
+            continue;
+          case '"':
+            for (p++; p < end && *p != '"' && *p != '\n'; p++)
+                ;
+            if (p < end && *p == '"')
+                p++;
+            continue;
+          case '/':
+            if (p + 1 < end && p[1] == '/') {
+                p = (const char *)memchr(p + 2, '\n', end - (p + 2));
+                if (p == NULL) p = end;
+                continue;
+            }
+            if (p + 1 < end && p[1] == '*') {
+                for (p += 2; p < end; p++) {
+                    p = (const char *)memchr(p, '*', end - p);
+                    if (p == NULL || (p + 1 < end && p[1] == '/'))
+                        break;
+                }
+                p = (p == NULL || p >= end) ? end : p + 2;
+                continue;
+            }
+            break;
+        }
+        p++;
+    }
+    return splits;
+}
+
+
+int ChunkedScan::NumChunks(Compilation *comp) {
+    size_t cores = std::thread::hardware_concurrency();
+    size_t n = comp->length / ChunkMinLength;
+    if (cores > 0 && n > cores)
+        n = cores;
+    return n < 2 ? 1 : n;
+}
+
+ChunkedScan::ChunkedScan(Compilation *comp, int numChunks) : stop(false) {
+    std::vector<size_t> splits = FindSplits(comp->text, comp->length, numChunks);
+    splits.push_back(comp->length);
+    for (size_t i = 0; i + 1 < splits.size(); i++) {
+        Chunk *c = new Chunk;
+        c->owner = this;
+        c->scanner = InitHandScanner(comp->text, splits[i], splits[i + 1]);
+        c->last = (i + 2 == splits.size());
+        c->entries.reserve((splits[i + 1] - splits[i]) / 4);   // about one token per 4 bytes
+        chunks.push_back(c);
+    }
+    cur = next = 0;
+    done = false;
+    for (size_t i = 0; i < chunks.size(); i++)
+        chunks[i]->thread = std::thread(&Chunk::Scan, chunks[i]);
+    PrintDebug("lex", "Scanning in %d chunks", (int)chunks.size());
+}
+
+ChunkedScan::~ChunkedScan() {
+    stop.store(true, std::memory_order_relaxed);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        Chunk *c = chunks[i];
+        if (c->thread.joinable())
+            c->thread.join();
+        for (size_t j = (i == cur ? next : 0); j < c->entries.size(); j++)
+            ScanSink::Discard(c->entries[j]);     // the ones before cur are empty
+        delete c;
+    }
+}
+
+
+/* ChunkedScan::Chunk::Scan
+ * ------------------------
+ * A chunk's thread: scans the chunk into its entries, or until the
+ * reader no longer wants them. Only the last chunk ends with the end of
+ * the input (token 0). As in TokenRing::Produce, the entry is reused
+ * from one token to the next.
+ */
+void ChunkedScan::Chunk::Scan() {
+    current = this;
+    Entry e;
+    memset(&e, 0, sizeof(e));
+    for (;;) {
+        e.token = HandScan(scanner, &e.value, &e.loc);
+        if ((e.token == 0 && !last) || !Put(e) || e.token == 0)
+            break;
+    }
+    current = NULL;
+}
+
+bool ChunkedScan::Chunk::Put(const Entry &e) {
+    if (owner->stop.load(std::memory_order_relaxed))
+        return false;
+    entries.push_back(e);
+    return true;
+}
+
+
+/* ChunkedScan::Next
+ * -----------------
+ * Reads the chunks' entries in order until one is a token, carrying out
+ * the errors and tabs before it. The parser waits for a chunk's thread
+ * only when it first gets to that chunk, and a chunk's entries are
+ * freed once they have all been read. The value is left alone at the
+ * end of the input, where the scanners do not set it either.
+ */
+int ChunkedScan::Next(YYSTYPE *lval, yyltype *lloc) {
+    while (!done) {
+        Chunk *c = chunks[cur];
+        if (next == 0 && c->thread.joinable())
+            c->thread.join();
+        if (next == c->entries.size()) {
+            Assert(cur + 1 < chunks.size());    // the last one ends with 0
+            std::vector<ScanSink::Entry>().swap(c->entries);
+            cur++;
+            next = 0;
+            continue;
+        }
+        const ScanSink::Entry &e = c->entries[next++];
+        if (ScanSink::CarryOut(e))
+            continue;
+        if (e.token != 0)
+            *lval = e.value;
+        *lloc = e.loc;
+        done = (e.token == 0);
+        return e.token;
+    }
+    return 0;
+}
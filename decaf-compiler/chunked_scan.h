@@ -0,0 +1,85 @@
+/* File: chunked_scan.h
+ * --------------------
+ * Chunked scanning. With -fscan-chunks, a program of at least
+ * 2 * ChunkMinLength bytes is split into chunks, one per core (but none
+ * shorter than ChunkMinLength), which are all scanned at once, each on
+ * a thread of its own, into an array of entries per chunk. The parser
+ * then reads the arrays one after another, waiting for each chunk's
+ * thread only when it gets to that chunk, so it can start on the first
+ * chunk while the others are still being scanned.
+ *
+ * The chunks are split just after a newline, but only one that is not
+ * inside a comment. Everything else ends at a newline (a string
+ * constant, a // comment, any other token or run of spaces), so the
+ * scanner is in the same state after such a newline whatever came before
+ * it, and scanning each chunk on its own gives the tokens scanning the
+ * whole program would. Whether a newline is inside a comment depends on
+ * everything before it, so finding the split points takes one pass over
+ * the program first. It only looks for the characters that open and
+ * close comments and strings, which is much quicker than scanning.
+ *
+ * Locations are offsets into the whole program, not line numbers, so a
+ * chunk's tokens need no correcting: each chunk's scanner counts from
+ * the start of the program. Errors and tabs are deferred as described
+ * in scan_ahead.h and carried out in order as the parser reaches them,
+ * so the output is the same as when scanning inline.
+ *
+ * The chunks are scanned by the hand-written scanner, which can start
+ * and stop anywhere in the program and never writes into it, so
+ * -fscan-chunks is only taken with -fhand-scanner. The hand-written
+ * scanner returns exactly what the flex scanner does (see
+ * hand_scanner.cc).
+ */
+
+#ifndef _H_chunked_scan
+#define _H_chunked_scan
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "scan_ahead.h"
+
+class Compilation;
+class HandScanner;
+
+const size_t ChunkMinLength = 1 << 20;   // bytes
+
+class ChunkedScan : public ScanAhead
+{
+  private:
+    class Chunk : public ScanSink
+    {
+      public:
+        ChunkedScan *owner;
+        HandScanner *scanner;
+        bool last;                  // of the program
+        std::vector<Entry> entries;
+        std::thread thread;
+
+        void Scan();
+        bool Put(const Entry &e);
+    };
+
+    std::vector<Chunk*> chunks;
+    size_t cur;                     // chunk being read, its thread joined
+    size_t next;                    // next entry to read in it
+    bool done;                      // reader has seen the end
+    std::atomic<bool> stop;         // reader is finished, scanners should quit
+
+    ChunkedScan(const ChunkedScan&);            // not copyable
+    ChunkedScan &operator=(const ChunkedScan&);
+
+  public:
+          // The number of chunks comp's program would be split into, 1
+          // if it is too short to be worth splitting
+    static int NumChunks(Compilation *comp);
+
+          // Splits comp's program into numChunks chunks (fewer if it has
+          // too few places to split) and starts scanning them
+    ChunkedScan(Compilation *comp, int numChunks);
+    ~ChunkedScan();
+
+    int Next(YYSTYPE *lval, yyltype *lloc);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Shared by lexdiff.bash and parsediff.bash, which define two functions,
+# first and second, that each compile the file named by $1 one way and
+# print what is to be compared, then source this file with the name of
+# what should agree. Both are run on every sample and must print the
+# same thing. Their output goes to temporary files that are removed on
+# exit. Run the script with -l to see the differences for the files
+# that fail.
+
+long=false
+if [ "$1" = "-l" ]
+then
+    long=true
+fi
+
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+pass=0
+tests=0
+
+
+flag=false
+for folder in samples/*;
+do
+    for file in $folder/*.decaf
+    do
+        tests=$((tests + 1))
+        first "$file" > "$tmp/first" 2>&1
+        second "$file" > "$tmp/second" 2>&1
+        echo -e -n "$file: "
+
+        d="$(diff "$tmp/first" "$tmp/second" 2>&1)"
+        if [ "$d" != "" ]
+        then
+            echo -e "\e[91mTest fail\e[39m"
+            if [ "$long" = true ]
+            then
+                echo -e "\e[31m$d\e[39m"
+            fi
+            flag=true
+        else
+            echo -e "\e[92mTest pass\e[39m"
+            pass=$((pass + 1))
+        fi
+    done
+done
+
+if [ "$flag" = "true" ]
+then
+    echo -e "\e[91m***************************"
+    echo "$pass / $tests $agree"
+    echo "***************************"
+    exit 1
+else
+    echo -e "\e[92m***************************"
+    echo "$pass / $tests $agree"
+    echo "***************************"
+fi
@@ -0,0 +1,155 @@
+/* File: compilation.cc
+ * --------------------
+ * Implementation of the Compilation class and the Compile entry point.
+ */
+
+#include <string.h>
+#include <sstream>
+#include "compilation.h"
+#include "scanner.h"
+#include "parser.h"
+#include "ast_type.h"
+#include "inheritance_hierarchy.h"
+#include "utility.h"
+
+thread_local Compilation *Compilation::active = NULL;
+
+
+/* Compilation::Compilation
+ * ------------------------
+ * Everything the run needs is made here, from the compilation's own
+ * arena, so it all goes when the arena does. The built-in types are
+ * made here too: they are shared by every node of the run but are not
+ * immutable (each caches its array type, which lives in the arena).
+ * With options.syntaxOnly nothing is checked, so none of the semantic
+ * state is made: the tables and built-in types are left NULL.
+ */
+Compilation::Compilation(char *t, size_t len, std::ostream &out, const Options &o)
+    : options(o) {
+    text = t;
+    length = len;
+    diagnostics = &out;
+    numErrors = 0;
+    curPos = 0;
+
+    Compilation *prev = Activate();
+    lineStarts = new List<SourcePos>;
+    tabStops = new List<TabStop>;
+    if (options.syntaxOnly) {
+        types = NULL;
+        bindings = NULL;
+        hierarchy = NULL;
+        namedTypes = NULL;
+        signatures = NULL;
+        intType = doubleType = voidType = boolType = nullType = stringType = errorType = NULL;
+    } else {
+        types = new Hashtable<Decl*>;
+        bindings = new (ArenaAlloc(sizeof(EnvVector::BindingStack))) EnvVector::BindingStack;
+        hierarchy = new InheritanceHierarchy;
+        namedTypes = new Hashtable<NamedType*>;
+        signatures = new Hashtable<Signature*>;
+        intType    = new Type("int");
+        doubleType = new Type("double");
+        voidType   = new Type("void");
+        boolType   = new Type("bool");
+        nullType   = new Type("null");
+        stringType = new Type("string");
+        errorType  = new Type("error");
+    }
+    InitScanner(this);
+    Deactivate(prev);
+}
+
+Compilation::~Compilation() {
+    EndScanner(this);
+    if (active == this)
+        Deactivate(NULL);
+    for (size_t i = 0; i < workerArenas.size(); i++)
+        delete workerArenas[i];
+}
+
+
+/* Compilation::Activate
+ * ---------------------
+ * Installs this compilation, its arena (unless the "noarena" debug key
+ * is on), its binding stack and its built-in types as the current ones
+ * on this thread.
+ */
+Compilation *Compilation::Activate() {
+    Compilation *prev = active;
+    active = this;
+    EnvVector::UseOwnBindings(false);
+    if (IsDebugOn("noarena"))
+        arena.Deactivate();
+    else
+        arena.Activate();
+    Type::intType = intType;
+    Type::doubleType = doubleType;
+    Type::voidType = voidType;
+    Type::boolType = boolType;
+    Type::nullType = nullType;
+    Type::stringType = stringType;
+    Type::errorType = errorType;
+    return prev;
+}
+
+void Compilation::ActivateWorker() {
+    Activate();
+    Arena *arena = WorkerArena();
+    if (arena)
+        arena->Activate();
+    EnvVector::UseOwnBindings(true);
+}
+
+Arena *Compilation::WorkerArena() {
+    if (IsDebugOn("noarena"))
+        return NULL;
+    Arena *arena = new Arena;
+    std::lock_guard<std::mutex> hold(typesLock);
+    workerArenas.push_back(arena);
+    return arena;
+}
+
+void Compilation::Deactivate(Compilation *prev) {
+    if (prev)
+        prev->Activate();
+    else {
+        active = NULL;
+        arena.Deactivate();
+        EnvVector::UseOwnBindings(false);
+        Type::intType = Type::doubleType = Type::voidType = Type::boolType =
+            Type::nullType = Type::stringType = Type::errorType = NULL;
+    }
+}
+
+int Compilation::Run() {
+    Assert(active == this);
+    if (options.syntaxOnly || options.handParser)
+        HandParse(this);
+    else
+        yyparse(this);
+    return numErrors;
+}
+
+
+Result Compile(const char *text, size_t length, bool syntaxOnly) {
+    char *copy = (char *)malloc(length + ScanPadding);
+    if (copy == NULL)
+        Failure("Out of memory copying %lu byte program", (unsigned long)length);
+    memcpy(copy, text, length);
+    memset(copy + length, 0, ScanPadding);
+
+    std::ostringstream diagnostics;
+    Result result;
+    {
+        Options options;
+        options.syntaxOnly = syntaxOnly;
+        Compilation comp(copy, length, diagnostics, options);
+        Compilation *prev = comp.Activate();
+        result.numErrors = comp.Run();
+        comp.Deactivate(prev);
+    }
+    free(copy);
+    result.diagnostics = diagnostics.str();
+    return result;
+}
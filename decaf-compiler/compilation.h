@@ -0,0 +1,164 @@
+/* File: compilation.h
+ * -------------------
+ * A Compilation is one run of the compiler over one program. It owns
+ * everything that run creates and changes: the arena every node comes
+ * from, the scanners and their line and tab tables, the type and
+ * scope tables, the built-in types, and the error count and stream.
+ * Nothing else in the compiler keeps per-run state, so any number of
+ * compilations can run in one process, one after another or at once
+ * on different threads.
+ *
+ * The code that scans, parses and checks does not take a Compilation
+ * as a parameter. It finds the one it is working for through Active(),
+ * which, like Arena::Active(), is per thread: Activate() makes this
+ * compilation (and its arena and built-in types) the current one on
+ * the calling thread until it is deactivated again. A compilation can
+ * only be active on one thread at a time.
+ *
+ * With -j, the function bodies are checked on several threads at once
+ * (see Program::Check). Each of the extra threads is a worker of the
+ * compilation, activated with ActivateWorker: it has an arena and a
+ * scope binding stack of its own, and the tables of types and
+ * signatures, which checking can add to, are shared under typesLock.
+ * The classes' members are indexed before that (see ClassDecl::LayOut)
+ * and only read after.
+ *
+ * The intern table (intern.h) and the debug keys (utility.h) are the
+ * only state shared between compilations. Interned names are never
+ * freed and interning is thread-safe; the debug keys are set once from
+ * the command line before anything is compiled.
+ *
+ * Library usage, for a program held in memory:
+ *
+ *       Result r = Compile(text, length);
+ *       if (r.numErrors > 0) std::cerr << r.diagnostics;
+ *
+ * or Compile(text, length, true) to only check that it parses.
+ */
+
+#ifndef _H_compilation
+#define _H_compilation
+
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "arena.h"
+#include "location.h"
+#include "list.h"
+#include "hashtable.h"
+#include "env_vector.h"
+#include "utility.h"
+
+class Decl;
+class NamedType;
+class Signature;
+class Type;
+class InheritanceHierarchy;
+class HandScanner;
+class ScanAhead;
+
+struct TabStop {
+    SourcePos pos;
+    int extraTotal;           // extra columns added by this tab and all before it
+};
+
+class Compilation
+{
+  private:
+    static thread_local Compilation *active;
+
+    std::vector<Arena*> workerArenas;           // see ActivateWorker
+
+    Compilation(const Compilation&);            // not copyable
+    Compilation &operator=(const Compilation&);
+
+  public:
+    Arena arena;                // every node, list and table of this run
+
+    // The program, see InitScanner
+    char *text;                 // followed by ScanPadding NUL bytes
+    size_t length;
+
+    // Scanner state, see scanner.l and hand_scanner.cc
+    void *flexScanner;          // the reentrant flex scanner (a yyscan_t)
+    char *flexText;             // its copy of text, NULL if it is not used
+    HandScanner *handScanner;   // NULL unless -fhand-scanner
+    ScanAhead *scanAhead;       // NULL unless scanning ahead of the parser
+    SourcePos curPos;           // where the flex scanner is
+    bool dumpTokens;
+    List<SourcePos> *lineStarts;  // built on first use, see GetLineForPos
+    List<TabStop> *tabStops;
+
+    const Options options;      // see utility.h
+
+    // Errors, see errors.h
+    std::ostream *diagnostics;  // where error messages go
+    int numErrors;
+
+    // Semantic state, all NULL with options.syntaxOnly
+    Hashtable<Decl*> *types;                // every class and interface
+    EnvVector::BindingStack *bindings;      // see env_vector.h
+    InheritanceHierarchy *hierarchy;
+    Hashtable<NamedType*> *namedTypes;      // canonical named types
+    Hashtable<Signature*> *signatures;
+    Type *intType, *doubleType, *boolType, *voidType,
+         *nullType, *stringType, *errorType;
+    std::mutex typesLock;       // namedTypes, signatures, array types and
+                                // the workers' arenas
+
+          // Sets up a compilation of the length characters at text, which
+          // must be followed by ScanPadding NUL bytes and must stay put
+          // until the compilation is destroyed. Errors are written to
+          // diagnostics.
+    Compilation(char *text, size_t length, std::ostream &diagnostics,
+                const Options &options = Options());
+    ~Compilation();
+
+          // Makes this the active compilation on the calling thread and
+          // returns the one that was active before (or NULL), which
+          // Deactivate puts back.
+    Compilation *Activate();
+    void Deactivate(Compilation *prev);
+    static Compilation *Active() { return active; }
+
+          // Makes this the active compilation on a worker thread, which
+          // checks functions while the thread it is already active on
+          // does too: as Activate, but with a new arena and binding stack
+          // for the thread, which last as long as the compilation.
+          // Deactivate(NULL) when the worker is done.
+    void ActivateWorker();
+
+          // Returns a new arena that lasts as long as the compilation, for
+          // a thread checking functions alongside workers, which must not
+          // take from the compilation's own arena meanwhile (the shared
+          // tables grow into it). NULL if arenas are off (-d noarena).
+    Arena *WorkerArena();
+
+          // Parses and checks the whole program, returns the number of
+          // errors reported. Must be active. Parses with bison, or with
+          // options.handParser with the hand-written parser. With
+          // options.syntaxOnly, only parses it, always with the
+          // hand-written parser (whatever options.handParser says) and
+          // its actions turned off (hand_parser.cc), so only lexical and
+          // syntax errors are found.
+    int Run();
+};
+
+
+/* Function: Compile
+ * -----------------
+ * Compiles the length characters at text (which need not be padded or
+ * NUL-terminated, they are copied) in a Compilation of its own, and
+ * returns the number of errors and their messages, exactly as dcc
+ * would have printed them (dcc -fsyntax-only if syntaxOnly is true).
+ * Safe to call from several threads at once.
+ */
+struct Result {
+    int numErrors;
+    std::string diagnostics;
+};
+
+Result Compile(const char *text, size_t length, bool syntaxOnly = false);
+
+#endif
@@ -0,0 +1,31 @@
+/* File: context.h
+ * ---------------
+ * A Context says where in the program a piece of code sits: the class
+ * and function it is inside and how many loops enclose it. Every scope
+ * carries the Context of the code it covers (see EnvVector::GetContext),
+ * so a check that needs to know, say, the return type of the enclosing
+ * function reads it off its scope instead of walking up the parent
+ * links of the tree. Scopes pushed inside another start with a copy of
+ * the enclosing scope's Context, so anything that walks the tree with
+ * scopes can rely on it, not just the semantic checker.
+ */
+
+#ifndef _H_context
+#define _H_context
+
+#include <stdlib.h>   // for NULL
+
+class ClassDecl;
+class FnDecl;
+class Type;
+
+struct Context {
+    ClassDecl *cls;     // enclosing class, NULL outside of one
+    FnDecl *fn;         // enclosing function or method, NULL outside of one
+    Type *returnType;   // declared return type of fn
+    int loopDepth;      // number of loops enclosing this point within fn
+
+    Context() : cls(NULL), fn(NULL), returnType(NULL), loopDepth(0) {}
+};
+
+#endif
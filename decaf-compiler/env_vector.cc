@@ -1,28 +1,83 @@
 #include "env_vector.h"
 #include "errors.h"
 #include "ast_expr.h"
+#include "compilation.h"
 
-Hashtable<Decl*> *EnvVector::types = new Hashtable<Decl*>;
+inline Hashtable<Decl*> *EnvVector::Types() {
+    return Compilation::Active()->types;
+}
+
+thread_local EnvVector::BindingStack *EnvVector::ownBindings = NULL;
+
+inline EnvVector::BindingStack *EnvVector::Bindings() {
+    return ownBindings ? ownBindings : Compilation::Active()->bindings;
+}
+
+void EnvVector::UseOwnBindings(bool own) {
+    ownBindings = own ? new (ArenaAlloc(sizeof(BindingStack))) BindingStack : NULL;
+}
 
 EnvVector::EnvVector() {
 
     env = new Hashtable<Decl*>;
     scope = GlobalScope;
     parent = NULL;
+    base = NULL;
+    level = 0;
+    mark = 0;
+}
+
+EnvVector::EnvVector(EnvVector *enclosing) {
+    BindingStack *bindings = Bindings();
+    env = NULL;
+    parent = enclosing;
+    scope = enclosing->scope;
+    ctx = enclosing->ctx;
+    if (enclosing->IsTransient()) {
+        Assert(enclosing->level == bindings->depth);
+        base = enclosing->base;
+        level = enclosing->level + 1;
+    } else {
+        Assert(bindings->depth == 0); // one function at a time per thread
+        base = enclosing;
+        level = 1;
+    }
+    bindings->depth = level;
+    mark = bindings->log.size();
 }
 
 void EnvVector::SetParent(EnvVector *other) {
+    Assert(!IsTransient());
     parent = other;
 }
 
 EnvVector* EnvVector::Push() {
+    Assert(!IsTransient());
     EnvVector *child = new EnvVector();
     child->parent = this;
     child->scope = scope;
+    child->ctx = ctx;
     return child;
 }
 
+EnvVector* EnvVector::PushTransient() {
+    return new EnvVector(this);
+}
+
 EnvVector* EnvVector::Pop() {
+    if (IsTransient()) {
+        BindingStack *bindings = Bindings();
+        Assert(level == bindings->depth);
+        while (bindings->log.size() > mark) {
+            Binding *b = &bindings->log.back();
+            if (b->outer)
+                bindings->top.Enter(b->name, b->outer);
+            else
+                bindings->top.Remove(b->name, b);
+            bindings->log.pop_back();
+        }
+        bindings->depth--;
+    }
     return parent;
 }
 
@@ -30,11 +85,32 @@ void EnvVector::SetScopeLevel(ScopeLevel s) {
     scope = s;
 }
 
+void EnvVector::SetFunction(FnDecl *fn) {
+    ctx.fn = fn;
+    ctx.returnType = fn->GetType();
+    ctx.loopDepth = 0;
+}
+
+EnvVector::Binding *EnvVector::Innermost(const char *name) {
+    Assert(level == Bindings()->depth);
+    return Bindings()->top.Lookup(name);
+}
+
 Decl* EnvVector::SearchInScope(Decl* id) {
+    if (IsTransient()) {
+        Binding *b = Innermost(id->getName());
+        return (b && b->level == level) ? b->decl : NULL;
+    }
     return env->Lookup(id->getName());
 }
 
 Decl* EnvVector::SearchN(Decl* id, int n) {
+    if (IsTransient()) {
+        Binding *b = Innermost(id->getName());
+        if (b)
+            return b->level > level - n ? b->decl : NULL;
+        return n > level ? base->SearchN(id, n - level) : NULL;
+    }
     EnvVector *h = this;
     Decl* s;
     for (int i = 0; i < n && h; i++) {
@@ -48,35 +124,53 @@ Decl* EnvVector::SearchN(Decl* id, int n) {
 }
 
 Decl* EnvVector::Search(Decl* id) {
+    return Search(id->getName());
+}
+
+
+/* Function: Search
+ * ----------------
+ * Finds the innermost declaration of id visible from this scope. If
+ * distance is given it is set to the number of scopes out from this one
+ * the declaration was found in (0 for this scope itself).
+ */
+Decl* EnvVector::Search(const char* id, int *distance) {
     EnvVector *h = this;
-    Decl* s;
+    Decl *s;
+    int d = 0;
+    if (IsTransient()) {
+        Binding *b = Innermost(id);
+        if (b) {
+            if (distance) *distance = level - b->level;
+            return b->decl;
+        }
+        h = base;
+        d = level;
+    }
     while(h) {
-        s = h->env->Lookup(id->getName());
-        if(s)
+        s = h->env->Lookup(id);
+        if(s) {
+            if (distance) *distance = d;
             return s;
+        }
         h = h->parent;
+        d++;
     }
     return NULL;
 }
 
-
-    Decl* EnvVector::Search(const char* id) {
-        EnvVector *h = this;
-        Decl *s;
-        while(h) {
-            s = h->env->Lookup(id);
-            if(s)
-                return s;
-            h = h->parent;
-        }
-        return NULL;
-    }
-
 bool EnvVector::InScope(Decl* id) {
-    return env->Lookup(id->getName()) != NULL;
+    return SearchInScope(id) != NULL;
 }
 
 void EnvVector::Insert(Decl* id) {
+    if (IsTransient()) {
+        BindingStack *bindings = Bindings();
+        Binding b = { id->getName(), id, level, Innermost(id->getName()) };
+        bindings->log.push_back(b);
+        bindings->top.Enter(b.name, &bindings->log.back());
+        return;
+    }
     env->Enter(id->getName(), id);
 }
 
@@ -90,35 +184,40 @@ bool EnvVector::InsertIfNotExists(Decl* id) {
 }
 
 bool EnvVector::TypeExists(Identifier *t) {
-    return EnvVector::types->Lookup(t->getName()) != NULL;
+    return Types()->Lookup(t->getName()) != NULL;
 }
 
 void EnvVector::AddType(Decl *t) {
-    return EnvVector::types->Enter(t->getName(), t);
+    return Types()->Enter(t->getName(), t);
 }
 
 Decl *EnvVector::GetTypeDecl(Identifier *t) {
-    return EnvVector::types->Lookup(t->getName());
+    return Types()->Lookup(t->getName());
 }
 
-Decl *EnvVector::GetTypeDecl(char *t) {
-    return EnvVector::types->Lookup(t);
+Decl *EnvVector::GetTypeDecl(const char *t) {
+    return Types()->Lookup(t);
 }
 
 EnvVector *EnvVector::GetProperScope(EnvVector *env, Expr *e) {
     if (e == NULL)
         return env;
 
-    // if this
-    if (This* t = dynamic_cast<This*>(e)) {
-        return t->GetClass()->GetEnv();
+    // if this (which is only valid inside a class)
+    if (This *th = dyn_cast<This>(e)) {
+        ClassDecl *cls = env->GetContext().cls;
+        if (cls == NULL) {
+            ReportError::ThisOutsideClassScope(th);
+            return NULL;
+        }
+        return cls->GetEnv();
     }
 
     // if var.field
-    if (FieldAccess *f = dynamic_cast<FieldAccess*>(e)) { 
+    if (FieldAccess *f = dyn_cast<FieldAccess>(e)) { 
         Decl* d =  env->Search(f->GetFieldName());
         if (d) {
-            if (NamedType* t = dynamic_cast<NamedType*>(d->GetType())) {
+            if (NamedType* t = dyn_cast<NamedType>(d->GetType())) {
                 Decl *e2 = env->GetTypeDecl(t->getID());
                 if (e2 == NULL) return env;
                 return e2->GetEnv();
@@ -135,6 +234,24 @@ EnvVector *EnvVector::GetProperScope(EnvVector *env, Expr *e) {
 void EnvVector::PrintScope() { 
     EnvVector *h = this;
     Decl* s;
+    if (IsTransient()) {
+        BindingStack *bindings = Bindings();
+        for (int l = level; l > 0; l--) {
+            Hashtable<Decl*> scope;
+            for (size_t i = 0; i < bindings->log.size(); i++) {
+                Binding &b = bindings->log[i];
+                if (b.level == l)
+                    scope.Enter(b.name, b.decl, false);
+            }
+            Iterator<Decl*> it = scope.GetIterator();
+            while((s = it.GetNextValue()) != NULL) {
+                std::cout << s << std::endl;
+            }
+
+            std::cout << std::endl;
+        }
+        h = base;
+    }
     while(h) {
         Iterator<Decl*> it = h->env->GetIterator();
         while((s = it.GetNextValue()) != NULL) {
@@ -1,6 +1,40 @@
+/* File: env_vector.h
+ * ------------------
+ * An EnvVector is one scope of the symbol table. Scopes come in two kinds.
+ *
+ * Persistent scopes (global, class and interface) are built once and
+ * searched for the rest of the compile, e.g. a class scope is searched
+ * again for every field access or call through an object of that class.
+ * Each one owns a Hashtable of its declarations and a parent link, and
+ * searching walks the parent chain. Class scopes have their parent
+ * pointed at the superclass scope once inheritance is resolved.
+ *
+ * Transient scopes (formals, blocks, if/while/for) only exist while the
+ * body of one function is being checked. They are many and mostly
+ * empty, so instead of a table each, they share one table of bindings
+ * (LeBlanc-Cook): every name maps to a stack of bindings, innermost on
+ * top, and each binding records the nesting level of the scope that
+ * made it. Push marks the end of an undo log; Pop unwinds the log back
+ * to the mark, uncovering whatever the popped bindings shadowed. Looking
+ * up a name is one hash probe however deep the nesting is, falling back
+ * to the enclosing persistent scope when no transient binding exists.
+ *
+ * Transient scopes must be popped in the reverse order they were pushed,
+ * and a transient scope can only be searched while it is the innermost
+ * one. Only one function is ever open at a time on each thread: the
+ * compilation has one binding stack, and each worker thread checking
+ * functions alongside it (see Program::Check) has one of its own.
+ *
+ * Every scope also carries the Context (see context.h) of the code it
+ * covers, copied from the enclosing scope when it is pushed.
+ */
+
 #ifndef _ENVVECTOR
 #define _ENVVECTOR
 
+#include <deque>
+#include "arena.h"
+#include "context.h"
 #include "hashtable.h"
 #include "ast_decl.h"
 #include "ast_type.h"
@@ -11,20 +45,57 @@ typedef enum { GlobalScope, ClassScope} ScopeLevel;
 
 class EnvVector {
 
+    friend class Compilation;       // which owns the types and bindings
+
     private:
-        Hashtable<Decl*> *env;
+        struct Binding {
+            const char *name;
+            Decl *decl;
+            int level;              // level of the scope that made it
+            Binding *outer;         // binding this one shadows, if any
+        };
+
+        struct BindingStack {
+            Hashtable<Binding*> top; // innermost binding for each name
+            std::deque<Binding, ArenaAllocator<Binding> > log; // undo log, in order of Insert
+            int depth;               // number of open transient scopes
+            BindingStack() : depth(0) {}
+        };
+
+        Hashtable<Decl*> *env;      // NULL for a transient scope
         EnvVector *parent;
-        static Hashtable<Decl*> *types;
+        static Hashtable<Decl*> *Types();      // of the active compilation
+        static BindingStack *Bindings();       // of this thread
+        static thread_local BindingStack *ownBindings; // see UseOwnBindings
         ScopeLevel scope;
+        Context ctx;
+
+        // transient scopes only
+        EnvVector *base;            // nearest enclosing persistent scope
+        int level;                  // 1 for formals, +1 per nested block
+        size_t mark;                // length of the log when pushed
+
+        EnvVector(EnvVector *enclosing);   // makes a transient scope
+        bool IsTransient() { return env == NULL; }
+        Binding *Innermost(const char *name);
 
-    
     public:
         EnvVector();
+
+        // Gives the calling thread a new binding stack of its own, from
+        // the active arena, or puts it back on the compilation's
+        static void UseOwnBindings(bool own);
+
+        // Scopes are never deleted, they live in the compilation arena
+        static void *operator new(size_t size) { return ArenaAlloc(size); }
+        static void operator delete(void *p) {}
+
         EnvVector* Push();
+        EnvVector* PushTransient();
         EnvVector* Pop();
         void SetParent(EnvVector *other);
         Decl* Search(Decl* id);
-        Decl* Search(const char* id);
+        Decl* Search(const char* id, int *distance = NULL);
         Decl* SearchInScope(Decl* id);
         Decl* SearchN(Decl* id, int n);
         bool InScope(Decl* id);
@@ -34,12 +105,17 @@ class EnvVector {
         void AddType(Decl *t);
         bool TypeExists(Identifier *t);
         Decl* GetTypeDecl(Identifier *t);
-        Decl* GetTypeDecl(char *t);
+        Decl* GetTypeDecl(const char *t);
 
         static EnvVector *GetProperScope(EnvVector *env, Expr *e);
 
         void SetScopeLevel(ScopeLevel s);
         bool IsInClassScope() { return scope == ClassScope; }
+
+        const Context &GetContext() { return ctx; }
+        void SetClass(ClassDecl *c) { ctx.cls = c; }
+        void SetFunction(FnDecl *fn);
+        void EnterLoop() { ctx.loopDepth++; }
         void PrintScope();
 };
 
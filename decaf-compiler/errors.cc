@@ -11,32 +11,63 @@
 using namespace std;
 
 #include "scanner.h" // for GetLineNumbered
+#include "utility.h" // for OutputBuffer
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
+#include "compilation.h"
+#include "scan_ahead.h"
 
-int ReportError::numErrors = 0;
+int ReportError::NumErrors() {
+    return Compilation::Active()->numErrors;
+}
 
-void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
-    if (!line) return;
-    cerr << line << endl;
-    for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
-    cerr << endl;
+void ReportError::UnderlineErrorInLine(ostream &out, TokenText line, int firstColumn, int lastColumn) {
+    if (!line.text) return;
+    out.write(line.text, line.length) << endl;
+    for (int i = 1; i <= lastColumn; i++)
+        out << (i >= firstColumn ? '^' : ' ');
+    out << endl;
 }
 
  
  
 void ReportError::OutputError(yyltype *loc, string msg) {
-    numErrors++;
-    fflush(stdout); // make sure any buffered text has been output
-    if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+    if (ScanSink *sink = ScanSink::Current()) {
+        sink->DeferError(loc, msg); // scanning ahead, see scan_ahead.h
+        return;
+    }
+    if (loc)
+        OutputError(GetLineForPos(loc->first), GetColumnForPos(loc->first),
+                    GetColumnForPos(loc->last), msg);
+    else
+        OutputError(0, 0, 0, msg);
+}
+
+/* Function: OutputError
+ * ---------------------
+ * Writes the message to the active compilation's diagnostics stream, or
+ * into the output buffer installed on this thread if there is one (see
+ * utility.h), which counts it when it is flushed.
+ */
+void ReportError::OutputError(int line, int firstColumn, int lastColumn, string msg) {
+    ostringstream out;
+    if (line > 0) {
+        out << endl << "*** Error line " << line << "." << endl;
+        UnderlineErrorInLine(out, GetLineNumbered(line), firstColumn, lastColumn);
     } else
-        cerr << endl << "*** Error." << endl;
-    cerr << "*** " << msg << endl << endl;
+        out << endl << "*** Error." << endl;
+    out << "*** " << msg << endl << endl;
+
+    if (OutputBuffer *buffer = OutputBuffer::Current()) {
+        buffer->Add(true, out.str());
+        return;
+    }
+    Compilation *comp = Compilation::Active();
+    comp->numErrors++;
+    fflush(stdout); // make sure any buffered text has been output
+    *comp->diagnostics << out.str() << flush;
 }
 
 
@@ -55,8 +86,7 @@ void ReportError::UntermComment() {
 }
 
 void ReportError::InvalidDirective(int linenum) {
-    yyltype ll = {0, linenum, 0, 0};
-    OutputError(&ll, "Invalid # directive");
+    OutputError(linenum, 0, 0, "Invalid # directive");
 }
 
 void ReportError::LongIdentifier(yyltype *loc, const char *ident) {
@@ -80,7 +110,7 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     stringstream s;
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
-      << prevDecl->GetLocation()->first_line;
+      << GetLineForPos(prevDecl->GetLocation()->first);
     OutputError(decl->GetLocation(), s.str());
 }
   
@@ -182,11 +212,11 @@ void ReportError::BreakOutsideLoop(BreakStmt *bStmt) {
  * -------------------
  * Standard error-reporting function expected by yacc. Our version merely
  * just calls into the error reporter above, passing the location of
- * the last token read. If you want to suppress the ordinary "parse error"
+ * the last token read (the parser is pure, so bison hands it over). If you want to suppress the ordinary "parse error"
  * message from yacc, you can implement yyerror to do nothing and
  * then call ReportError::Formatted yourself with a more descriptive 
  * message.
  */
-void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+void yyerror(yyltype *loc, Compilation *comp, const char *msg) {
+    ReportError::Formatted(loc, "%s", msg);
 }
@@ -13,8 +13,10 @@
 #define _H_errors
 
 #include <string>
+#include <iosfwd>
 using std::string;
 #include "location.h"
+#include "scanner.h"    // for TokenText
 class Type;
 class Identifier;
 class Expr;
@@ -23,6 +25,7 @@ class ReturnStmt;
 class This;
 class Decl;
 class Operator;
+class ScanSink;
 
 /* General notes on using this class
  * ----------------------------------
@@ -33,7 +36,7 @@ class Operator;
  * on this class are static, thus you can invoke methods directly via
  * the class name, e.g.
  *
- *    if (missingEnd) ReportError::UntermString(&yylloc, str);
+ *    if (missingEnd) ReportError::UntermString(yylloc, str);
  *
  * For some methods, the first argument is the pointer to the location
  * structure that identifies where the problem is (usually this is the
@@ -104,14 +107,17 @@ class ReportError
   static void Formatted(yyltype *loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
-  static int NumErrors() { return numErrors; }
+  // Returns number of error messages printed by the active compilation.
+  // Messages go to its diagnostics stream (see compilation.h)
+  static int NumErrors();
   
  private:
 
-  static void UnderlineErrorInLine(const char *line, yyltype *pos);
+  static void UnderlineErrorInLine(std::ostream &out, TokenText line, int firstColumn, int lastColumn);
   static void OutputError(yyltype *loc, string msg);
-  static int numErrors;
+  static void OutputError(int line, int firstColumn, int lastColumn, string msg);
+
+  friend class ScanSink; // outputs the errors it deferred
   
 };
 
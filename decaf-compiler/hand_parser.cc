@@ -0,0 +1,956 @@
+/* File: hand_parser.cc
+ * --------------------
+ * A hand-written recursive-descent parser for Decaf, used in place of
+ * the bison one with -fhand-parser (see Compilation::Run). It builds the same tree, node for node and
+ * location for location, and reports the same syntax error at the same
+ * token. Each function below follows the rules in parser.y it stands
+ * for, so a change to the grammar there needs the same change here.
+ * Running the samples with -d ast through both parsers (parsediff.bash)
+ * checks the two agree.
+ *
+ * With -fsyntax-only the same parser runs with its actions turned off:
+ * it takes the same tokens and reports the same errors, but makes no
+ * nodes or lists, and nothing is checked (see Make below).
+ *
+ * Declarations are parsed by recursive descent, statements the same way
+ * but with the ones they are nested in kept on a stack instead of the C
+ * stack (see Statements below), and expressions by precedence over the
+ * %left and %nonassoc table in parser.y, also without recursion (see
+ * Expressions below), so that however deeply statements and expressions
+ * nest, parsing them takes no more of the C stack.
+ *
+ * There are no error rules in parser.y, so the first syntax error ends
+ * the parse. Bison reports it at the lookahead token where no move is
+ * possible, and never reads a token past it; the same goes here. Each
+ * Parse function returns whether it parsed what it was called for, with
+ * what it built in its last argument, so once Error() has reported the
+ * error every caller returns false in turn, without reading any more. The
+ * one place a single token of lookahead does not decide is an
+ * identifier at the start of a block, which starts a declaration if
+ * the next token is an identifier or [] and a statement otherwise. Bison
+ * reads that next token at the same point, so the same tokens are read
+ * in both, and any errors the scanner reports come out in the same
+ * places.
+ */
+
+#include <string.h>
+#include <vector>
+#include "parser.h"
+#include "scanner.h"
+#include "errors.h"
+#include "compilation.h"
+#include "utility.h"
+
+void yyerror(yyltype *loc, Compilation *comp, const char *msg); // in errors.cc
+
+class HandParser
+{
+  public:
+    Compilation *comp;
+    bool build;             // false with -fsyntax-only, see Make
+    int tok;                // the lookahead
+    YYSTYPE val;            // its value and location
+    yyltype loc;
+    yyltype prev;           // location of the last token taken
+    bool peeked;            // the token after tok has been read, see Peek()
+    int nextTok;
+    YYSTYPE nextVal;
+    yyltype nextLoc;
+    bool failed;            // a syntax error has been reported, see Error()
+    YYSTYPE scanVal;        // what the scanner writes into, kept from one
+    yyltype scanLoc;        // token to the next as bison keeps yylval/yylloc
+
+    enum PendingKind { NegatePending, NotPending, BinaryPending, AssignPending,
+                       ParenPending, ArgumentsPending, SubscriptPending,
+                       ArraySizePending };
+
+    struct Pending {        // a construct waiting for an expression, see ParseExpr
+        PendingKind kind;
+        yyltype start;          // of the operand it is part of
+        Expr *left;             // left operand, or base of a call or subscript
+        Operator *op;
+        int level;              // of a binary operator
+        Identifier *field;      // called, with the arguments so far
+        List<Expr*> *actuals;
+    };
+    std::vector<Pending> pending;
+
+    enum UnfinishedKind { BlockUnfinished, IfUnfinished, ElseUnfinished,
+                          WhileUnfinished, ForUnfinished };
+
+    struct Unfinished {     // a statement waiting for one in it, see ParseStmt
+        UnfinishedKind kind;
+        Expr *test, *init, *step;
+        Stmt *body;             // of an if, while its else is read
+        List<VarDecl*> *decls;  // of a block, with its statements so far
+        List<Stmt*> *stmts;
+    };
+    std::vector<Unfinished> unfinished;
+
+    HandParser(Compilation *c);
+
+    template <class T, class... Args> T *Make(Args... args);
+    template <class T> List<T> *MakeList() { return build ? new List<T> : NULL; }
+    template <class T, class E> void Add(List<T> *list, E elem) { if (list) list->Append(elem); }
+    Expr *MakeBinary(Expr *left, Operator *op, Expr *right, int level);
+
+    int Scan(YYSTYPE *v, yyltype *l);
+    void Advance();
+    int Peek();
+    bool Error();
+    bool Expect(int t);
+    bool ExpectIdentifier(const char **name, yyltype *idLoc);
+
+    bool AtDecl();
+    bool ParseDecl(Decl **decl);
+    bool ParseReturnType(Type **type);
+    bool ParseMember(Decl **decl);
+    bool ParseFnHeader(Type *returnType, yyltype idLoc, const char *name, FnDecl **fn);
+    bool ParseVariable(VarDecl **var);
+    bool ParseClass(Decl **decl);
+    bool ParseInterface(Decl **decl);
+    bool ParseType(Type **type);
+    bool AtVarDecl();
+    bool ParseBlock(StmtBlock **block);
+    bool ParseStmt(Stmt **stmt);
+    bool StartStmt(Stmt **stmt);
+    bool FinishStmt(Stmt **stmt, size_t outer);
+    bool ParseExpr(Expr **expr);
+    void Push(PendingKind kind, yyltype start, Expr *left, Operator *op);
+    bool ParseOperand(Expr **expr);
+    bool ParsePostfix(Expr **expr, yyltype start, bool isLValue);
+    bool OpenCall(yyltype start, Expr *base, Identifier *field, Expr **call);
+    bool Complete(Expr **expr, size_t outer);
+};
+
+
+/* Binary operator levels
+ * ----------------------
+ * From the precedence table in parser.y, lowest first ('=' is below them
+ * all and handled apart). Equality and relational operators are
+ * %nonassoc: two at the same level in a row are a syntax error.
+ */
+enum { NotBinary, OrLevel, AndLevel, EqualityLevel, RelationalLevel,
+       AdditiveLevel, MultiplicativeLevel };
+
+static int BinaryLevel(int t) {
+    switch (t) {
+      case T_Or:            return OrLevel;
+      case T_And:           return AndLevel;
+      case T_Equal: case T_NotEqual:
+                            return EqualityLevel;
+      case '<': case '>': case T_LessEqual: case T_GreaterEqual:
+                            return RelationalLevel;
+      case '+': case '-':   return AdditiveLevel;
+      case '*': case '/': case '%':
+                            return MultiplicativeLevel;
+      default:              return NotBinary;
+    }
+}
+
+static const char *OperatorName(int t) {
+    switch (t) {
+      case T_Or:            return "||";
+      case T_And:           return "&&";
+      case T_Equal:         return "==";
+      case T_NotEqual:      return "!=";
+      case T_LessEqual:     return "<=";
+      case T_GreaterEqual:  return ">=";
+      case '<':             return "<";
+      case '>':             return ">";
+      case '+':             return "+";
+      case '-':             return "-";
+      case '*':             return "*";
+      case '/':             return "/";
+      case '%':             return "%";
+      default:              return "=";
+    }
+}
+
+
+/* Function: Make
+ * --------------
+ * Every node the parser builds is made here, and every list through
+ * MakeList and Add. With -fsyntax-only nothing is made: every node and
+ * list is NULL, and Add does nothing. So the parse never goes by
+ * whether a node is NULL (see Expressions below), and what is done with
+ * a node other than passing it on to Make is only done if it is there.
+ */
+template <class T, class... Args> T *HandParser::Make(Args... args) {
+    return build ? new T(args...) : NULL;
+}
+
+Expr *HandParser::MakeBinary(Expr *left, Operator *op, Expr *right, int level) {
+    switch (level) {
+      case OrLevel: case AndLevel:
+        return Make<LogicalExpr>(left, op, right);
+      case EqualityLevel:
+        return Make<EqualityExpr>(left, op, right);
+      case RelationalLevel:
+        return Make<RelationalExpr>(left, op, right);
+      default:
+        return Make<ArithmeticExpr>(left, op, right);
+    }
+}
+
+
+HandParser::HandParser(Compilation *c) {
+    comp = c;
+    build = !c->options.syntaxOnly;
+    peeked = false;
+    failed = false;
+    memset(&scanVal, 0, sizeof(scanVal));
+    scanLoc.first = scanLoc.last = 0;   // as bison's yylloc starts out
+    prev = loc = scanLoc;
+    tok = 0;
+}
+
+int HandParser::Scan(YYSTYPE *v, yyltype *l) {
+    int t = yylex(&scanVal, &scanLoc, comp);
+    *v = scanVal;
+    *l = scanLoc;
+    return t;
+}
+
+void HandParser::Advance() {
+    prev = loc;
+    if (peeked) {
+        tok = nextTok;
+        val = nextVal;
+        loc = nextLoc;
+        peeked = false;
+    } else
+        tok = Scan(&val, &loc);
+}
+
+int HandParser::Peek() {
+    if (!peeked) {
+        nextTok = Scan(&nextVal, &nextLoc);
+        peeked = true;
+    }
+    return nextTok;
+}
+
+/* Function: Error
+ * ---------------
+ * Reports a syntax error at the lookahead, as bison would, and returns
+ * false for the caller to return: the parse ends there.
+ */
+bool HandParser::Error() {
+    yyerror(&loc, comp, "syntax error");
+    failed = true;
+    return false;
+}
+
+bool HandParser::Expect(int t) {
+    if (tok != t)
+        return Error();
+    Advance();
+    return true;
+}
+
+bool HandParser::ExpectIdentifier(const char **name, yyltype *idLoc) {
+    if (tok != T_Identifier)
+        return Error();
+    *name = val.identifier;
+    *idLoc = loc;
+    Advance();
+    return true;
+}
+
+
+        // Arena bytes the tree takes for each byte of the program, about:
+        // generated programs with -d arena come to 17 to 20
+static const size_t TreeBytesPerByte = 20;
+
+/* Function: HandParse
+ * -------------------
+ * Parses the active compilation's program and, unless there were errors
+ * or it is only to be parsed (-fsyntax-only), checks it, as yyparse
+ * does. Returns 0, or 1 after a syntax error.
+ *
+ * The tree is about TreeBytesPerByte times the size of the program, so
+ * that much is reserved in the arena first, in one block, instead of
+ * being taken a BlockSize at a time as the parse goes.
+ *
+ * Bison reduces to Program (by default, whatever the lookahead) as soon
+ * as a token cannot start another Decl, and only then finds out whether
+ * that token is the end of the input. So a program whose declarations
+ * are followed by something else is printed and checked before the
+ * syntax error is reported, and so it is here.
+ */
+int HandParse(Compilation *comp) {
+    HandParser p(comp);
+    if (p.build && Arena::Active() != NULL)
+        Arena::Active()->Reserve(comp->length * TreeBytesPerByte);
+    List<Decl*> *decls = p.MakeList<Decl*>();
+    Decl *decl;
+    p.Advance();
+    do {
+        if (!p.ParseDecl(&decl))
+            return 1;
+        p.Add(decls, decl);
+    } while (p.AtDecl());
+
+    if (decls != NULL) {
+        Program *program = new Program(decls);
+        if (IsDebugOn("ast"))
+            program->Print(0);
+        // if no errors, advance to next phase
+        if (ReportError::NumErrors() == 0)
+            program->Check();
+    }
+    if (p.tok != 0) {
+        p.Error();
+        return 1;
+    }
+    return 0;
+}
+
+
+/* Declarations
+ * ------------
+ * Decl, Field and FnHeader: a variable or function starts with its type
+ * (or void) and name, and what follows the name tells which it is.
+ */
+bool HandParser::AtDecl() {
+    switch (tok) {
+      case T_Class: case T_Interface: case T_Void: case T_Identifier:
+      case T_Int: case T_Bool: case T_String: case T_Double:
+        return true;
+      default:
+        return false;
+    }
+}
+
+bool HandParser::ParseDecl(Decl **decl) {
+    switch (tok) {
+      case T_Class:     return ParseClass(decl);
+      case T_Interface: return ParseInterface(decl);
+      default:          return ParseMember(decl);
+    }
+}
+
+bool HandParser::ParseReturnType(Type **type) {
+    if (tok != T_Void)
+        return ParseType(type);
+    Advance();
+    *type = Type::voidType;
+    return true;
+}
+
+bool HandParser::ParseMember(Decl **decl) {
+    bool isVoid = (tok == T_Void);
+    Type *type;
+    const char *name;
+    yyltype idLoc;
+    if (!ParseReturnType(&type) || !ExpectIdentifier(&name, &idLoc))
+        return false;
+    if (tok == ';' && !isVoid) {
+        Advance();
+        *decl = Make<VarDecl>(Make<Identifier>(idLoc, name), type);
+        return true;
+    }
+    FnDecl *fn;
+    StmtBlock *body;
+    if (!ParseFnHeader(type, idLoc, name, &fn) || !ParseBlock(&body))
+        return false;
+    if (fn != NULL)
+        fn->SetFunctionBody(body);
+    *decl = fn;
+    return true;
+}
+
+        // the rest of a FnHeader, from the '(' after the name
+bool HandParser::ParseFnHeader(Type *returnType, yyltype idLoc, const char *name, FnDecl **fn) {
+    if (!Expect('('))
+        return false;
+    List<VarDecl*> *formals = MakeList<VarDecl*>();
+    VarDecl *formal;
+    if (tok != ')') {
+        if (!ParseVariable(&formal))
+            return false;
+        Add(formals, formal);
+        while (tok == ',') {
+            Advance();
+            if (!ParseVariable(&formal))
+                return false;
+            Add(formals, formal);
+        }
+    }
+    if (!Expect(')'))
+        return false;
+    *fn = Make<FnDecl>(Make<Identifier>(idLoc, name), returnType, formals);
+    return true;
+}
+
+bool HandParser::ParseVariable(VarDecl **var) {
+    Type *type;
+    const char *name;
+    yyltype idLoc;
+    if (!ParseType(&type) || !ExpectIdentifier(&name, &idLoc))
+        return false;
+    *var = Make<VarDecl>(Make<Identifier>(idLoc, name), type);
+    return true;
+}
+
+bool HandParser::ParseClass(Decl **decl) {
+    Advance();
+    yyltype idLoc, loc2;
+    const char *name, *other;
+    if (!ExpectIdentifier(&name, &idLoc))
+        return false;
+    NamedType *extends = NULL;
+    if (tok == T_Extends) {
+        Advance();
+        if (!ExpectIdentifier(&other, &loc2))
+            return false;
+        extends = Make<NamedType>(Make<Identifier>(loc2, other));
+    }
+    List<NamedType*> *implements = MakeList<NamedType*>();
+    if (tok == T_Implements) {
+        do {
+            Advance();
+            if (!ExpectIdentifier(&other, &loc2))
+                return false;
+            Add(implements, Make<NamedType>(Make<Identifier>(loc2, other)));
+        } while (tok == ',');
+    }
+    if (!Expect('{'))
+        return false;
+    List<Decl*> *members = MakeList<Decl*>();
+    Decl *member;
+    while (tok != '}') {
+        if (!ParseMember(&member))
+            return false;
+        Add(members, member);
+    }
+    Advance();
+    *decl = Make<ClassDecl>(Make<Identifier>(idLoc, name), extends, implements, members);
+    return true;
+}
+
+bool HandParser::ParseInterface(Decl **decl) {
+    Advance();
+    yyltype idLoc, fnLoc;
+    const char *name, *fnName;
+    if (!ExpectIdentifier(&name, &idLoc) || !Expect('{'))
+        return false;
+    List<Decl*> *members = MakeList<Decl*>();
+    Type *type;
+    FnDecl *fn;
+    while (tok != '}') {
+        if (!ParseReturnType(&type) || !ExpectIdentifier(&fnName, &fnLoc) ||
+            !ParseFnHeader(type, fnLoc, fnName, &fn) || !Expect(';'))
+            return false;
+        Add(members, fn);
+    }
+    Advance();
+    *decl = Make<InterfaceDecl>(Make<Identifier>(idLoc, name), members);
+    return true;
+}
+
+/* Function: ParseType
+ * -------------------
+ * A built-in type is the shared Type object, as in parser.y. Each []
+ * makes an ArrayType spanning the whole type so far.
+ */
+bool HandParser::ParseType(Type **result) {
+    yyltype start = loc;
+    Type *type;
+    switch (tok) {
+      case T_Int:        type = Type::intType; break;
+      case T_Bool:       type = Type::boolType; break;
+      case T_String:     type = Type::stringType; break;
+      case T_Double:     type = Type::doubleType; break;
+      case T_Identifier: type = Make<NamedType>(Make<Identifier>(loc, val.identifier)); break;
+      default:           return Error();
+    }
+    Advance();
+    while (tok == T_Dims) {
+        type = Make<ArrayType>(Join(start, loc), type);
+        Advance();
+    }
+    *result = type;
+    return true;
+}
+
+
+/* Statements
+ * ----------
+ * A block's declarations all come before its statements. An identifier
+ * there starts a declaration only if an identifier or [] follows it.
+ */
+bool HandParser::AtVarDecl() {
+    switch (tok) {
+      case T_Int: case T_Bool: case T_String: case T_Double:
+        return true;
+      case T_Identifier:
+        return Peek() == T_Identifier || Peek() == T_Dims;
+      default:
+        return false;
+    }
+}
+
+bool HandParser::ParseBlock(StmtBlock **block) {
+    Stmt *stmt;
+    if (tok != '{')
+        return Error();
+    if (!ParseStmt(&stmt))
+        return false;
+    *block = cast<StmtBlock>(stmt);
+    return true;
+}
+
+/* Function: ParseStmt
+ * -------------------
+ * Parses a statement without taking more of the C stack for each one it
+ * is nested in. StartStmt reads a statement up to the first statement
+ * nested in it, if any, and pushes it on unfinished to wait for it; then
+ * FinishStmt puts the statement that was read into the unfinished one
+ * it is in, and that into the one it is in, and so on, until one needs
+ * another statement. As ParseExpr does for expressions.
+ */
+bool HandParser::ParseStmt(Stmt **stmt) {
+    size_t outer = unfinished.size();
+    while (!StartStmt(stmt) || !FinishStmt(stmt, outer))
+        if (failed)
+            return false;
+    return true;
+}
+
+/* Function: StartStmt
+ * -------------------
+ * Reads a statement into *stmt and returns true, or returns false if
+ * what was read is waiting for a statement nested in it.
+ */
+bool HandParser::StartStmt(Stmt **result) {
+    yyltype start = loc;
+    Stmt *&stmt = *result;
+    Expr *expr;
+    Unfinished u;
+    u.test = u.init = u.step = NULL;
+    u.body = NULL;
+    u.decls = NULL;
+    u.stmts = NULL;
+    switch (tok) {
+      case ';':
+        Advance();
+        stmt = Make<EmptyExpr>();
+        return true;
+      case '{': {
+        Advance();
+        u.kind = BlockUnfinished;
+        u.decls = MakeList<VarDecl*>();
+        VarDecl *decl;
+        while (AtVarDecl()) {
+            if (!ParseVariable(&decl) || !Expect(';'))
+                return false;
+            Add(u.decls, decl);
+        }
+        u.stmts = MakeList<Stmt*>();
+        if (tok == '}') {
+            Advance();
+            stmt = Make<StmtBlock>(u.decls, u.stmts);
+            return true;
+        }
+        break;
+      }
+      case T_If:
+        Advance();
+        u.kind = IfUnfinished;
+        if (!Expect('(') || !ParseExpr(&u.test) || !Expect(')'))
+            return false;
+        break;
+      case T_While:
+        Advance();
+        u.kind = WhileUnfinished;
+        if (!Expect('(') || !ParseExpr(&u.test) || !Expect(')'))
+            return false;
+        break;
+      case T_For:
+        Advance();
+        u.kind = ForUnfinished;
+        if (!Expect('('))
+            return false;
+        if (tok == ';')
+            u.init = Make<EmptyExpr>();
+        else if (!ParseExpr(&u.init))
+            return false;
+        if (!Expect(';') || !ParseExpr(&u.test) || !Expect(';'))
+            return false;
+        if (tok == ')')
+            u.step = Make<EmptyExpr>();
+        else if (!ParseExpr(&u.step))
+            return false;
+        if (!Expect(')'))
+            return false;
+        break;
+      case T_Return: {
+        Advance();
+        if (tok == ';') {
+            Advance();
+            stmt = Make<ReturnStmt>(start, Make<EmptyExpr>());
+            return true;
+        }
+        yyltype exprStart = loc;
+        if (!ParseExpr(&expr))
+            return false;
+        yyltype span = Join(exprStart, prev);
+        if (!Expect(';'))
+            return false;
+        stmt = Make<ReturnStmt>(span, expr);
+        return true;
+      }
+      case T_Print: {
+        Advance();
+        if (!Expect('(') || !ParseExpr(&expr))
+            return false;
+        List<Expr*> *args = MakeList<Expr*>();
+        Add(args, expr);
+        while (tok == ',') {
+            Advance();
+            if (!ParseExpr(&expr))
+                return false;
+            Add(args, expr);
+        }
+        if (!Expect(')') || !Expect(';'))
+            return false;
+        stmt = Make<PrintStmt>(args);
+        return true;
+      }
+      case T_Break:
+        Advance();
+        if (!Expect(';'))
+            return false;
+        stmt = Make<BreakStmt>(start);
+        return true;
+      default:
+        if (!ParseExpr(&expr) || !Expect(';'))
+            return false;
+        stmt = expr;
+        return true;
+    }
+    unfinished.push_back(u);
+    return false;
+}
+
+/* Function: FinishStmt
+ * --------------------
+ * Puts the statement in *stmt into the unfinished ones above outer, the
+ * innermost first, as far as the lookahead allows. Returns true, with
+ * the whole statement in *stmt, once there is nothing left unfinished
+ * above outer, or false when another statement comes next: the next in
+ * a block, or the else of an if.
+ */
+bool HandParser::FinishStmt(Stmt **result, size_t outer) {
+    Stmt *&stmt = *result;
+    while (unfinished.size() > outer) {
+        Unfinished &u = unfinished.back();
+        switch (u.kind) {
+          case BlockUnfinished:
+            Add(u.stmts, stmt);
+            if (tok != '}')
+                return false;
+            Advance();
+            stmt = Make<StmtBlock>(u.decls, u.stmts);
+            break;
+          case IfUnfinished:
+            if (tok == T_Else) {
+                Advance();
+                u.kind = ElseUnfinished;
+                u.body = stmt;
+                return false;
+            }
+            stmt = Make<IfStmt>(u.test, stmt, (Stmt *)NULL);
+            break;
+          case ElseUnfinished:
+            stmt = Make<IfStmt>(u.test, u.body, stmt);
+            break;
+          case WhileUnfinished:
+            stmt = Make<WhileStmt>(u.test, stmt);
+            break;
+          case ForUnfinished:
+            stmt = Make<ForStmt>(u.init, u.test, u.step, stmt);
+            break;
+        }
+        unfinished.pop_back();
+    }
+    return true;
+}
+
+
+/* Expressions
+ * -----------
+ * However deeply an expression nests, parsing it takes no more of the C
+ * stack: what recursion would keep in its frames is kept instead on
+ * pending, one Pending for each construct that has been started and is
+ * waiting for an expression to finish it. An operand is read by
+ * ParseOperand, which pushes a Pending for each prefix operator and
+ * opening parenthesis it meets before the primary, and ParsePostfix,
+ * which does the same for subscripts, arguments and assignments after
+ * it. Then Complete applies the operand to what is pending, as far as
+ * the lookahead allows. Each of these returns whether the operand is
+ * finished, since the operand itself is NULL with -fsyntax-only; after a
+ * syntax error they return false too, and ParseExpr sees failed set.
+ *
+ * Binary operators are handled by precedence: the pending ones at the
+ * top of the stack always have rising levels, so a new operator first
+ * completes those at its level or above (its left operand), which is
+ * what the %left and %nonassoc declarations in parser.y make bison do.
+ * A %nonassoc operator completing one of its own level is a syntax
+ * error there. Unary minus and '!' bind tighter than every binary
+ * operator, and '.' and '[' tighter still, so they stay with the
+ * operand they follow. And '=' can only follow an LValue, so an LValue
+ * followed by '=' is always an assignment (bison shifts there, at any
+ * level), whose right side takes every binary operator after it.
+ */
+bool HandParser::ParseExpr(Expr **expr) {
+    size_t outer = pending.size();
+    while (!ParseOperand(expr) || !Complete(expr, outer))
+        if (failed)
+            return false;
+    return true;
+}
+
+void HandParser::Push(PendingKind kind, yyltype start, Expr *left, Operator *op) {
+    Pending p;
+    p.kind = kind;
+    p.start = start;
+    p.left = left;
+    p.op = op;
+    p.level = NotBinary;
+    p.field = NULL;
+    p.actuals = NULL;
+    pending.push_back(p);
+}
+
+/* Function: ParseOperand
+ * ----------------------
+ * Reads an operand into *expr and returns true, or returns false if
+ * what was read opened something that an expression comes next in.
+ */
+bool HandParser::ParseOperand(Expr **result) {
+    yyltype start = loc, idLoc;
+    const char *name;
+    bool isLValue = false;
+    Expr *&expr = *result;
+    switch (tok) {
+      case '-':
+      case '!':
+        Push(tok == '-' ? NegatePending : NotPending, start, NULL,
+             Make<Operator>(loc, tok == '-' ? "-" : "!"));
+        Advance();
+        return false;
+      case '(':
+        Push(ParenPending, start, NULL, NULL);
+        Advance();
+        return false;
+      case T_NewArray:
+        Advance();
+        if (!Expect('('))
+            return false;
+        Push(ArraySizePending, start, NULL, NULL);
+        return false;
+      case T_Identifier:
+        ExpectIdentifier(&name, &idLoc);
+        if (tok == '(') {
+            if (!OpenCall(start, NULL, Make<Identifier>(idLoc, name), &expr))
+                return false;
+        } else {
+            expr = Make<FieldAccess>((Expr *)NULL, Make<Identifier>(idLoc, name));
+            isLValue = true;
+        }
+        break;
+      case T_IntConstant:
+        expr = Make<IntConstant>(loc, val.integerConstant);
+        Advance();
+        break;
+      case T_BoolConstant:
+        expr = Make<BoolConstant>(loc, val.boolConstant);
+        Advance();
+        break;
+      case T_DoubleConstant:
+        expr = Make<DoubleConstant>(loc, val.doubleConstant);
+        Advance();
+        break;
+      case T_StringConstant:
+        expr = Make<StringConstant>(loc, val.stringConstant.text, val.stringConstant.length);
+        Advance();
+        break;
+      case T_Null:
+        expr = Make<NullConstant>(loc);
+        Advance();
+        break;
+      case T_This:
+        expr = Make<This>(loc);
+        Advance();
+        break;
+      case T_ReadInteger:
+      case T_ReadLine: {
+        int t = tok;
+        Advance();
+        if (!Expect('(') || !Expect(')'))
+            return false;
+        if (t == T_ReadInteger)
+            expr = Make<ReadIntegerExpr>(Join(start, prev));
+        else
+            expr = Make<ReadLineExpr>(Join(start, prev));
+        break;
+      }
+      case T_New:
+        Advance();
+        if (!Expect('(') || !ExpectIdentifier(&name, &idLoc) || !Expect(')'))
+            return false;
+        expr = Make<NewExpr>(Join(start, prev), Make<NamedType>(Make<Identifier>(idLoc, name)));
+        break;
+      default:
+        return Error();
+    }
+    return ParsePostfix(result, start, isLValue);
+}
+
+/* Function: ParsePostfix
+ * ----------------------
+ * Reads the field accesses, calls and subscripts after *expr, which
+ * starts at start, and then (if what was built is an LValue in the
+ * grammar's sense, which a parenthesized one is not) an assignment to
+ * it. The location of a call or subscript spans from start. Leaves the
+ * operand in *expr and returns true, or returns false if a subscript,
+ * the arguments of a call or the right side of an assignment comes next.
+ */
+bool HandParser::ParsePostfix(Expr **result, yyltype start, bool isLValue) {
+    yyltype idLoc;
+    Expr *&expr = *result;
+    for (;;) {
+        if (tok == '.') {
+            Advance();
+            const char *name;
+            if (!ExpectIdentifier(&name, &idLoc))
+                return false;
+            if (tok == '(') {
+                if (!OpenCall(start, expr, Make<Identifier>(idLoc, name), &expr))
+                    return false;
+                isLValue = false;
+            } else {
+                expr = Make<FieldAccess>(expr, Make<Identifier>(idLoc, name));
+                isLValue = true;
+            }
+        } else if (tok == '[') {
+            Advance();
+            Push(SubscriptPending, start, expr, NULL);
+            return false;
+        } else if (tok == '=' && isLValue) {
+            Push(AssignPending, start, expr, Make<Operator>(loc, "="));
+            Advance();
+            return false;
+        } else
+            return true;
+    }
+}
+
+/* Function: OpenCall
+ * ------------------
+ * Takes the '(' after the name of a call. If there are no arguments,
+ * also takes the ')', sets *call to the call and returns true. If there
+ * are, pushes the call for them to be read into and returns false.
+ */
+bool HandParser::OpenCall(yyltype start, Expr *base, Identifier *field, Expr **call) {
+    Advance();
+    if (tok == ')') {
+        Advance();
+        *call = Make<Call>(Join(start, prev), base, field, MakeList<Expr*>());
+        return true;
+    }
+    Push(ArgumentsPending, start, base, NULL);
+    pending.back().field = field;
+    pending.back().actuals = MakeList<Expr*>();
+    return false;
+}
+
+/* Function: Complete
+ * ------------------
+ * Applies the operand in *expr to what is pending above outer: the
+ * prefix operators waiting for it, then the binary operators the
+ * lookahead completes, and then, if the lookahead is not another binary
+ * operator, whatever the whole expression was opened by, and so on
+ * outwards. Returns true, with the expression in *expr, once there is
+ * nothing left pending above outer, or false when another operand comes
+ * next.
+ */
+bool HandParser::Complete(Expr **result, size_t outer) {
+    Expr *&expr = *result;
+    for (;;) {
+        while (pending.size() > outer) {
+            Pending &p = pending.back();
+            if (p.kind == NegatePending)
+                expr = Make<ArithmeticExpr>(p.op, expr);
+            else if (p.kind == NotPending)
+                expr = Make<LogicalExpr>(p.op, expr);
+            else
+                break;
+            pending.pop_back();
+        }
+
+        int t = tok, level = BinaryLevel(t);
+        while (pending.size() > outer && pending.back().kind == BinaryPending &&
+               pending.back().level >= level) {
+            Pending &p = pending.back();
+            if (p.level == level && (level == EqualityLevel || level == RelationalLevel))
+                return Error();
+            expr = MakeBinary(p.left, p.op, expr, p.level);
+            pending.pop_back();
+        }
+        if (level != NotBinary) {
+            Push(BinaryPending, loc, expr, Make<Operator>(loc, OperatorName(t)));
+            pending.back().level = level;
+            Advance();
+            return false;
+        }
+
+        if (pending.size() == outer)
+            return true;
+        Pending p = pending.back();
+        pending.pop_back();
+        switch (p.kind) {
+          case AssignPending:
+            expr = Make<AssignExpr>(p.left, p.op, expr);
+            continue;
+          case ParenPending:
+            if (!Expect(')') || !ParsePostfix(&expr, p.start, false))
+                return false;
+            break;
+          case ArgumentsPending:
+            Add(p.actuals, expr);
+            if (tok == ',') {
+                Advance();
+                pending.push_back(p);
+                return false;
+            }
+            if (!Expect(')'))
+                return false;
+            expr = Make<Call>(Join(p.start, prev), p.left, p.field, p.actuals);
+            if (!ParsePostfix(&expr, p.start, false))
+                return false;
+            break;
+          case SubscriptPending:
+            if (!Expect(']'))
+                return false;
+            expr = Make<ArrayAccess>(Join(p.start, prev), p.left, expr);
+            if (!ParsePostfix(&expr, p.start, true))
+                return false;
+            break;
+          case ArraySizePending: {
+            Type *elemType;
+            if (!Expect(',') || !ParseType(&elemType) || !Expect(')'))
+                return false;
+            expr = Make<NewArrayExpr>(Join(p.start, prev), expr, elemType);
+            if (!ParsePostfix(&expr, p.start, false))
+                return false;
+            break;
+          }
+          default:
+            Assert(0);      // the others never reach here
+        }
+    }
+}
@@ -0,0 +1,335 @@
+/* File: hand_scanner.cc
+ * ---------------------
+ * A hand-written scanner for Decaf, used in place of the flex one with
+ * -fhand-scanner (see InitScanner in scanner.l). It
+ * returns exactly what the flex scanner does: the same tokens, values
+ * and locations, the same errors, and the same tab stops. Each case
+ * below follows the rule in scanner.l it stands for, including flex's
+ * longest-match and first-rule-wins behavior, so a change to the rules
+ * there needs the same change here. Running the samples with -d tokens
+ * through both scanners (lexdiff.bash) checks the two agree.
+ *
+ * The input is the whole program in one buffer that is followed by
+ * ScanPadding NUL bytes. The long runs (spaces, identifiers, digits,
+ * the insides of comments and strings) are skipped 16 bytes at a time
+ * with SSE2 where it is available, which is safe because the padding
+ * keeps the loads inside the buffer and no run continues into a NUL.
+ */
+
+#include <string.h>
+#include <string>
+#include "scanner.h"
+#include "utility.h"
+#include "errors.h"
+#include "parser.h" // for token codes, YYSTYPE
+#include "intern.h"
+#include "keywords.h"
+#include "arena.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+class HandScanner
+{
+  public:
+    const char *text;       // start of the program
+    const char *end;        // just past its last character
+    const char *cur;        // where the next token starts
+    bool inComment;         // inside /* */, the flex COMM state
+    YYSTYPE *yylval;        // where the token being scanned goes
+    yyltype *yylloc;
+
+    const char *Find(const char *p, char a, char b);
+    void Match(const char *first, const char *last);
+    bool ScanComment();
+    int ScanNumber(const char *p);
+    int Scan();
+};
+
+
+/* Functions: character classes
+ * ----------------------------
+ * The classes used by the definitions in scanner.l.
+ */
+static inline bool IsAlpha(char c) { return (unsigned)((c | 0x20) - 'a') < 26; }
+static inline bool IsDigit(char c) { return (unsigned)(c - '0') < 10; }
+static inline bool IsHexDigit(char c) { return IsDigit(c) || (unsigned)((c | 0x20) - 'a') < 6; }
+static inline bool IsIdentChar(char c) { return IsAlpha(c) || IsDigit(c) || c == '_'; }
+
+
+/* Functions: run skipping
+ * -----------------------
+ * Each returns the first position at or after p that does not continue
+ * the run. None of the runs include NUL, so each stops in the padding
+ * at the latest.
+ */
+#ifdef __SSE2__
+
+static inline unsigned Mask(__m128i m) { return _mm_movemask_epi8(m); }
+static inline __m128i Load(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+
+        // bytes of v in [lo, hi], as a mask of 0xff/0x00 bytes; lo and hi
+        // must be ASCII, so bytes >= 0x80 (negative) are never in range
+static inline __m128i InRange(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+static const char *SkipSpaces(const char *p) {
+    for (;; p += 16) {
+        unsigned m = ~Mask(_mm_cmpeq_epi8(Load(p), _mm_set1_epi8(' '))) & 0xffff;
+        if (m) return p + __builtin_ctz(m);
+    }
+}
+
+static const char *SkipIdentChars(const char *p) {
+    for (;; p += 16) {
+        __m128i v = Load(p);
+        __m128i in = _mm_or_si128(InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+                     _mm_or_si128(InRange(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+        unsigned m = ~Mask(in) & 0xffff;
+        if (m) return p + __builtin_ctz(m);
+    }
+}
+
+static const char *SkipDigits(const char *p) {
+    for (;; p += 16) {
+        unsigned m = ~Mask(InRange(Load(p), '0', '9')) & 0xffff;
+        if (m) return p + __builtin_ctz(m);
+    }
+}
+
+        // first of a, b or NUL
+static const char *FindEither(const char *p, char a, char b) {
+    for (;; p += 16) {
+        __m128i v = Load(p);
+        unsigned m = Mask(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)),
+                                                    _mm_cmpeq_epi8(v, _mm_set1_epi8(b))),
+                                       _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+        if (m) return p + __builtin_ctz(m);
+    }
+}
+
+#else
+
+static const char *SkipSpaces(const char *p)     { while (*p == ' ') p++; return p; }
+static const char *SkipIdentChars(const char *p) { while (IsIdentChar(*p)) p++; return p; }
+static const char *SkipDigits(const char *p)     { while (IsDigit(*p)) p++; return p; }
+static const char *FindEither(const char *p, char a, char b) {
+    while (*p != a && *p != b && *p != '\0') p++;
+    return p;
+}
+
+#endif
+
+        // first of a or b at or after p, or end if neither comes before it
+const char *HandScanner::Find(const char *p, char a, char b) {
+    while ((p = FindEither(p, a, b)) < end && *p == '\0')
+        p++; // a NUL inside the program, keep going
+    return p < end ? p : end;
+}
+
+
+/* Function: Match
+ * ---------------
+ * Records that the text from first up to (not including) last was
+ * matched, as the flex YY_USER_ACTION does, and moves past it.
+ */
+inline void HandScanner::Match(const char *first, const char *last) {
+    yylloc->first = first - text;
+    yylloc->last = last - text - 1;
+    cur = last;
+}
+
+
+/* Function: InitHandScanner
+ * -------------------------
+ * Returns a scanner for the characters of the program at t from offset
+ * first up to (not including) last, with locations counted from t. The
+ * program must be followed by ScanPadding NUL bytes. Unless last is the
+ * end of the program, it must come just after a newline that is not in
+ * a comment (see chunked_scan.h): no token or comment continues across
+ * one, and no run skipped above goes past it. It comes from the active
+ * arena.
+ */
+HandScanner *InitHandScanner(const char *t, size_t first, size_t last) {
+    HandScanner *s = new (ArenaAlloc(sizeof(HandScanner))) HandScanner;
+    s->text = t;
+    s->cur = t + first;
+    s->end = t + last;
+    s->inComment = false;
+    s->yylval = NULL;
+    s->yylloc = NULL;
+    return s;
+}
+
+
+/* Function: ScanComment
+ * ---------------------
+ * Skips the rest of a multi-line comment, the flex COMM state. Flex
+ * goes one character at a time there, so the location left behind is
+ * that of the last character (or of the closing star-slash). Tabs
+ * count as usual.
+ * Returns false if the input ends first.
+ */
+bool HandScanner::ScanComment() {
+    const char *p = cur;
+    for (;;) {
+        const char *q = Find(p, '*', '\t');
+        if (q > p) Match(q - 1, q);
+        if (q == end) return false;
+        if (*q == '\t') {
+            RecordTab(q - text);
+            Match(q, q + 1);
+        } else if (q[1] == '/' && q + 1 < end) {
+            Match(q, q + 2);
+            return true;
+        } else
+            Match(q, q + 1);
+        p = cur;
+    }
+}
+
+
+/* Function: ScanNumber
+ * --------------------
+ * {INTEGER}, {HEX_INTEGER} or {DOUBLE}, whichever is longest starting
+ * at p (the first digit). The text is converted in place: the character
+ * after each of these can never continue the number for strtol or atof.
+ */
+int HandScanner::ScanNumber(const char *p) {
+    const char *digits = SkipDigits(p + 1), *hex = NULL, *dbl = NULL;
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && IsHexDigit(p[2])) {
+        hex = p + 3;
+        while (IsHexDigit(*hex)) hex++;
+    }
+    if (*digits == '.') {
+        dbl = SkipDigits(digits + 1);
+        const char *e = dbl;
+        if (*e == 'E' || *e == 'e') {
+            e++;
+            if (*e == '+' || *e == '-') e++;
+            if (IsDigit(*e)) dbl = SkipDigits(e);
+        }
+    }
+    if (dbl && dbl > digits && (!hex || dbl > hex)) {
+        Match(p, dbl);
+        yylval->doubleConstant = atof(p);
+        return T_DoubleConstant;
+    }
+    if (hex && hex > digits) {
+        Match(p, hex);
+        yylval->integerConstant = strtol(p, NULL, 16);
+        return T_IntConstant;
+    }
+    Match(p, digits);
+    yylval->integerConstant = strtol(p, NULL, 10);
+    return T_IntConstant;
+}
+
+
+/* Function: HandScan
+ * ------------------
+ * Returns the next token, 0 at the end of the input, with its value in
+ * lval and its location in lloc.
+ */
+int HandScan(HandScanner *s, YYSTYPE *lval, yyltype *lloc) {
+    s->yylval = lval;
+    s->yylloc = lloc;
+    return s->Scan();
+}
+
+int HandScanner::Scan() {
+    if (inComment && !ScanComment()) {
+        ReportError::UntermComment();
+        return 0;
+    }
+    inComment = false;
+    for (;;) {
+        const char *p = cur;
+        if (p >= end)
+            return 0;
+        char c = *p;
+        switch (c) {
+          case ' ':
+            Match(p, SkipSpaces(p + 1));
+            continue;
+          case '\n':
+            Match(p, p + 1);
+            continue;
+          case '\t':
+            RecordTab(p - text);
+            Match(p, p + 1);
+            continue;
+          case '/':
+            if (p[1] == '*' && p + 1 < end) {
+                Match(p, p + 2);
+                if (!ScanComment()) {
+                    inComment = true;
+                    ReportError::UntermComment();
+                    return 0;
+                }
+                continue;
+            }
+            if (p[1] == '/' && p + 1 < end) {
+                Match(p, Find(p + 2, '\n', '\n'));
+                continue;
+            }
+            break;
+          case '"': {
+            const char *q = Find(p + 1, '"', '\n');
+            if (q < end && *q == '"') {
+                Match(p, q + 1);
+                yylval->stringConstant.text = p;
+                yylval->stringConstant.length = q + 1 - p;
+                return T_StringConstant;
+            }
+            Match(p, q);
+            ReportError::UntermString(yylloc, std::string(p, q - p).c_str());
+            continue;
+          }
+          case '<': case '>': case '=': case '!':
+            if (p[1] == '=' && p + 1 < end) {
+                Match(p, p + 2);
+                return c == '<' ? T_LessEqual : c == '>' ? T_GreaterEqual
+                     : c == '=' ? T_Equal : T_NotEqual;
+            }
+            break;
+          case '&': case '|':
+            if (p[1] == c && p + 1 < end) {
+                Match(p, p + 2);
+                return c == '&' ? T_And : T_Or;
+            }
+            break;
+          case '[':
+            if (p[1] == ']' && p + 1 < end) {
+                Match(p, p + 2);
+                return T_Dims;
+            }
+            break;
+        }
+
+        if (IsAlpha(c)) {
+            const char *q = SkipIdentChars(p + 1);
+            int len = q - p;
+            Match(p, q);
+            if (int token = KeywordToken(p, len)) {
+                if (token == T_BoolConstant)
+                    yylval->boolConstant = (c == 't');
+                return token;
+            }
+            if (len > MaxIdentLen)
+                ReportError::LongIdentifier(yylloc, std::string(p, len).c_str());
+            yylval->identifier = Intern(p, len > MaxIdentLen ? MaxIdentLen : len);
+            return T_Identifier;
+        }
+        if (IsDigit(c))
+            return ScanNumber(p);
+
+        Match(p, p + 1);
+        if (c != '\0' && strchr("-+/*%=.,;!<>()[]{}", c))
+            return c;
+        ReportError::UnrecogChar(yylloc, c);
+    }
+}
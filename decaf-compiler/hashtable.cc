@@ -1,45 +1,180 @@
 /* File: hashtable.cc
  * ------------------
  * Implementation of Hashtable class.
+ *
+ * Robin Hood hashing: every key lives in the first free slot at or after
+ * its home slot (hash & mask), and on insert an entry that is further
+ * from home than the occupant of a slot takes the slot over, pushing the
+ * occupant along. This keeps probe sequences short and lets a failed
+ * lookup stop as soon as it meets an entry closer to home than the probe
+ * so far. Removal shifts the following entries back instead of leaving
+ * tombstones.
  */
-   
+
+#include <stdlib.h>
+#include <algorithm>
+#include "utility.h"
+
+
+template <class Value> Hashtable<Value>::~Hashtable()
+{
+  for (unsigned i = 0; i < capacity; i++)
+    delete slots[i].shadowed;
+  if (!arena)
+    free(slots);
+}
+
+
+/* Hashtable::Find
+ * ---------------
+ * Returns the slot holding key, or NULL if key is not in the table.
+ */
+template <class Value> typename Hashtable<Value>::Slot *Hashtable<Value>::Find(const char *key) const
+{
+  if (capacity == 0)
+    return NULL;
+  unsigned mask = capacity - 1;
+  unsigned i = InternedHash(key) & mask;
+  for (unsigned dist = 0; ; dist++, i = (i + 1) & mask) {
+    Slot *s = &slots[i];
+    if (s->key == NULL || s->dist < dist)
+      return NULL;
+    if (s->key == key)
+      return s;
+  }
+}
+
+
+/* Hashtable::Place
+ * ----------------
+ * Inserts an entry for a key known not to be in the table. Assumes
+ * there is room.
+ */
+template <class Value> void Hashtable<Value>::Place(Slot s)
+{
+  unsigned mask = capacity - 1;
+  unsigned i = s.hash & mask;
+  for (s.dist = 0; ; s.dist++, i = (i + 1) & mask) {
+    if (slots[i].key == NULL) {
+      slots[i] = s;
+      return;
+    }
+    if (slots[i].dist < s.dist)
+      std::swap(slots[i], s);
+  }
+}
+
+
+template <class Value> void Hashtable<Value>::Grow()
+{
+  Slot *old = slots;
+  unsigned oldCapacity = capacity;
+  capacity = capacity ? capacity * 2 : 8;
+  if (arena) {
+    slots = (Slot *)arena->Alloc(capacity * sizeof(Slot));
+    memset(slots, 0, capacity * sizeof(Slot));
+  } else
+    slots = (Slot *)calloc(capacity, sizeof(Slot));
+  if (slots == NULL)
+    Failure("Out of memory growing hashtable to %u slots", capacity);
+  for (unsigned i = 0; i < oldCapacity; i++)
+    if (old[i].key)
+      Place(old[i]);
+  if (!arena)
+    free(old);
+}
+
+
+/* Hashtable::Erase
+ * ----------------
+ * Empties a slot, shifting back any entries after it that are not
+ * already in their home slot so no probe sequence is broken.
+ */
+template <class Value> void Hashtable<Value>::Erase(Slot *s)
+{
+  unsigned mask = capacity - 1;
+  unsigned i = s - slots;
+  delete slots[i].shadowed;
+  for (;;) {
+    unsigned next = (i + 1) & mask;
+    if (slots[next].key == NULL || slots[next].dist == 0)
+      break;
+    slots[i] = slots[next];
+    slots[i].dist--;
+    i = next;
+  }
+  memset(&slots[i], 0, sizeof(Slot));
+  numKeys--;
+}
+
 
 /* Hashtable::Enter
  * ----------------
  * Stores new value for given identifier. If the key already
- * has an entry and flag is to overwrite, will remove previous entry first,
- * otherwise it just adds another entry under same key. Copies the
- * key, so you don't have to worry about its allocation.
+ * has an entry and flag is to overwrite, will replace the latest
+ * entry, otherwise it just adds another entry under same key.
+ * The key must be an interned name and is not copied.
  */
 template <class Value> void Hashtable<Value>::Enter(const char *key, Value val, bool overwrite)
 {
-  Value prev;
-  if (overwrite && (prev = Lookup(key)))
-    Remove(key, prev);
-  mmap.insert(std::make_pair(strdup(key), val));
+  Slot *s = Find(key);
+  if (s) {
+    if (!overwrite) {
+      if (!s->shadowed)
+        s->shadowed = new std::vector<Value>;
+      s->shadowed->push_back(s->value);
+      numEntries++;
+    }
+    s->value = val;
+    return;
+  }
+
+  if (4 * (numKeys + 1) > 3 * capacity) // keep load at most 3/4
+    Grow();
+  Slot fresh;
+  fresh.key = key;
+  fresh.hash = InternedHash(key);
+  fresh.dist = 0;
+  fresh.value = val;
+  fresh.shadowed = NULL;
+  Place(fresh);
+  numKeys++;
+  numEntries++;
 }
 
- 
+
 /* Hashtable::Remove
  * -----------------
  * Removes a given key-value pair from table. If no such pair, no
  * changes are made.  Does not affect any other entries under that key.
+ * If the pair was entered more than once, the oldest one goes.
  */
 template <class Value> void Hashtable<Value>::Remove(const char *key, Value val)
 {
-  if (mmap.count(key) == 0) // no matches at all
+  Slot *s = Find(key);
+  if (s == NULL) // no matches at all
     return;
 
-  typename std::multimap<const char *, Value>::iterator itr;
-  itr = mmap.find(key); // start at first occurrence
-  while (itr != mmap.upper_bound(key)) {
-    if (itr->second == val) { // iterate to find matching pair
-	mmap.erase(itr);
-	break;
+  if (s->shadowed) {
+    typename std::vector<Value>::iterator itr;
+    itr = std::find(s->shadowed->begin(), s->shadowed->end(), val);
+    if (itr != s->shadowed->end()) {
+      s->shadowed->erase(itr);
+      numEntries--;
+      return;
     }
-    ++itr;
   }
-} 
+  if (s->value != val)
+    return;
+
+  numEntries--;
+  if (s->shadowed && !s->shadowed->empty()) {
+    s->value = s->shadowed->back();
+    s->shadowed->pop_back();
+  } else {
+    Erase(s);
+  }
+}
 
 
 /* Hashtable::Lookup
@@ -47,23 +182,10 @@ template <class Value> void Hashtable<Value>::Remove(const char *key, Value val)
  * Returns the value earlier stored under key or NULL
  *if there is no matching entry
  */
-template <class Value> Value Hashtable<Value>::Lookup(const char *key) 
+template <class Value> Value Hashtable<Value>::Lookup(const char *key) const
 {
-  Value found = NULL;
-  
-  if (mmap.count(key) > 0) {
-    typename std::multimap<const char *, Value>::iterator cur, last, prev;
-    cur = mmap.find(key); // start at first occurrence
-    last = mmap.upper_bound(key);
-    while (cur != last) { // iterate to find last entered
-	prev = cur; 
-	if (++cur == mmap.upper_bound(key)) { // have to go one too far
-	  found = prev->second; // one before last was it
-	  break;
-	}
-    }
-  }
-  return found;
+  Slot *s = Find(key);
+  return s ? s->value : NULL;
 }
 
 
@@ -72,18 +194,38 @@ template <class Value> Value Hashtable<Value>::Lookup(const char *key)
  */
 template <class Value> int Hashtable<Value>::NumEntries() const
 {
-  return mmap.size();
+  return numEntries;
 }
 
 
-
 /* Hashtable:GetIterator
  * ---------------------
  * Returns iterator which can be used to walk through all values in table.
+ * Keys are sorted alphabetically; the values under one key come out in
+ * the order they were entered.
  */
-template <class Value> Iterator<Value> Hashtable<Value>::GetIterator() 
+struct KeyOrder {
+  template <class S> bool operator()(const S *a, const S *b) const
+  { return strcmp(a->key, b->key) < 0; }
+};
+
+template <class Value> Iterator<Value> Hashtable<Value>::GetIterator() const
 {
-  return Iterator<Value>(mmap);
+  std::vector<Slot *> used;
+  used.reserve(numKeys);
+  for (unsigned i = 0; i < capacity; i++)
+    if (slots[i].key)
+      used.push_back(&slots[i]);
+  std::sort(used.begin(), used.end(), KeyOrder());
+
+  Iterator<Value> it;
+  it.values.reserve(numEntries);
+  for (size_t i = 0; i < used.size(); i++) {
+    if (used[i]->shadowed)
+      it.values.insert(it.values.end(), used[i]->shadowed->begin(), used[i]->shadowed->end());
+    it.values.push_back(used[i]->value);
+  }
+  return it;
 }
 
 
@@ -94,6 +236,6 @@ template <class Value> Iterator<Value> Hashtable<Value>::GetIterator()
  */
 template <class Value> Value Iterator<Value>::GetNextValue()
 {
-  return (cur == end ? NULL : (*cur++).second);
+  return (cur == values.size() ? NULL : values[cur++]);
 }
 
@@ -1,13 +1,15 @@
 /* File: hashtable.h
  * -----------------
  * This is a simple table for storing values associated with a string
- * key, supporting simple operations for Enter and Lookup.  It is not
- * much more than a thin cover over the STL associative map container,
- * but hides the awkward C++ template syntax and provides a more
- * familiar interface.
+ * key, supporting simple operations for Enter and Lookup.  It is an
+ * open-addressing hash table (Robin Hood linear probing) laid out as
+ * one flat array of slots, so a lookup is normally a single cache line
+ * touched rather than a walk down a tree.
  *
- * The keys are always strings, but the values can be of any type
- * (ok, that's actually kind of a fib, it expects the type to be
+ * The keys are always interned names (see intern.h): keys are compared
+ * by pointer and hashed with the hash computed when they were interned,
+ * so no string is hashed, compared or copied here.  The values can be of
+ * any type (ok, that's actually kind of a fib, it expects the type to be
  * some sort of pointer to conform to using NULL for "not found").
  * The typename for a Hashtable includes the value type in angle
  * brackets, e.g.  if the table is storing  char *as values, you
@@ -16,9 +18,15 @@
  * The same notation is used on the matching iterator for the table,
  * i.e. a Hashtable<char*> supports an Iterator<char*>.
  *
- * An iterator is provided for iterating over the entries in a table. 
+ * Like a List, a table takes its slots from the arena that was active
+ * when it was made (see arena.h), or from the heap if none was, and a
+ * table made with new lives in that arena too.
+ *
+ * An iterator is provided for iterating over the entries in a table.
  * The iterator walks through the values, one by one, in alphabetical
- * order by the key. Sample iteration usage:
+ * order by the key (sorting is done when the iterator is created, so
+ * the output does not depend on where things landed in the table).
+ * Sample iteration usage:
  *
  *       void PrintNames(Hashtable<Decl*> *table)
  *       {
@@ -33,31 +41,53 @@
 #ifndef _H_hashtable
 #define _H_hashtable
 
-#include <map>
+#include <vector>
 #include <string.h>
-
-struct ltstr {
-  bool operator()(const char* s1, const char* s2) const
-  { return strcmp(s1, s2) < 0; }
-};
+#include "arena.h"
+#include "intern.h"
 
 
 template <class Value> class Iterator;
 
 template<class Value> class Hashtable {
 
-  private: 
-     std::multimap<const char*, Value, ltstr> mmap;
- 
+  private:
+     struct Slot {
+        const char *key;          // NULL if slot is empty
+        unsigned hash;
+        unsigned dist;            // how far this slot is from its home
+        Value value;              // most recently entered value for key
+        std::vector<Value> *shadowed; // older values, oldest first (rare)
+     };
+
+     Slot *slots;
+     unsigned capacity;           // always 0 or a power of 2
+     unsigned numKeys;
+     int numEntries;
+     Arena *arena;                // where the slots come from, NULL for heap
+
+     Slot *Find(const char *key) const;
+     void Place(Slot s);
+     void Grow();
+     void Erase(Slot *s);
+
+     Hashtable(const Hashtable&);           // not copyable
+     Hashtable &operator=(const Hashtable&);
+
    public:
             // ctor creates a new empty hashtable
-     Hashtable() {}
+     Hashtable() : slots(NULL), capacity(0), numKeys(0), numEntries(0),
+                   arena(Arena::Active()) {}
+     ~Hashtable();
+
+     static void *operator new(size_t size) { return ArenaAlloc(size); }
+     static void operator delete(void *p) {}
 
            // Returns number of entries currently in table
      int NumEntries() const;
 
            // Associates value with key. If a previous entry for
-           // key exists, the bool parameter controls whether 
+           // key exists, the bool parameter controls whether
            // new value overwrites the previous (removing it from
            // from the table entirely) or just shadows it (keeps previous
            // and adds additional entry). The lastmost entered one for an
@@ -74,11 +104,11 @@ template<class Value> class Hashtable {
           // Returns value stored under key or NULL if no match.
           // If more than one value for key (ie shadow feature was
           // used during Enter), returns the lastmost entered one.
-     Value Lookup(const char *key);
+     Value Lookup(const char *key) const;
 
           // Returns an Iterator object (see below) that can be used to
           // visit each value in the table in alphabetical order.
-     Iterator<Value> GetIterator();
+     Iterator<Value> GetIterator() const;
 
 };
 
@@ -91,9 +121,9 @@ template<class Value> class Iterator {
   friend class Hashtable<Value>;
 
   private:
-    typename std::multimap<const char*, Value , ltstr>::iterator cur, end;
-    Iterator(std::multimap<const char*, Value, ltstr>& t)
-      : cur(t.begin()), end(t.end()) {}
+    std::vector<Value> values;
+    size_t cur;
+    Iterator() : cur(0) {}
 
   public:
          // Returns current value and advances iterator to next.
@@ -0,0 +1,144 @@
+/* File: hashtable_bench.cc
+ * ------------------------
+ * Times Hashtable against the std::multimap-backed table it replaced,
+ * at each table size given on the command line (10, 1000 and 100000 if
+ * none are). Keys are interned names, as they are in the compiler. For
+ * each size this prints the time per Enter into an empty table, per
+ * Lookup of a key that is there and per Lookup of one that is not.
+ * Built by "make hashtable_bench" and run from bench.bash.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <vector>
+#include "hashtable.h"
+#include "intern.h"
+
+
+/* The table as it was before Hashtable: a multimap ordered by strcmp,
+ * with Enter, Remove and Lookup as they were written for it.
+ */
+struct ltstr {
+    bool operator()(const char *s1, const char *s2) const
+    { return strcmp(s1, s2) < 0; }
+};
+
+template <class Value> class MultimapTable {
+  private:
+    std::multimap<const char*, Value, ltstr> mmap;
+
+  public:
+    void Enter(const char *key, Value val, bool overwrite = true) {
+        Value prev;
+        if (overwrite && (prev = Lookup(key)))
+            Remove(key, prev);
+        mmap.insert(std::make_pair(strdup(key), val));
+    }
+
+    void Remove(const char *key, Value val) {
+        if (mmap.count(key) == 0)
+            return;
+        typename std::multimap<const char*, Value, ltstr>::iterator itr;
+        itr = mmap.find(key);
+        while (itr != mmap.upper_bound(key)) {
+            if (itr->second == val) {
+                mmap.erase(itr);
+                break;
+            }
+            ++itr;
+        }
+    }
+
+    Value Lookup(const char *key) {
+        Value found = NULL;
+        if (mmap.count(key) > 0) {
+            typename std::multimap<const char*, Value, ltstr>::iterator cur, last, prev;
+            cur = mmap.find(key);
+            last = mmap.upper_bound(key);
+            while (cur != last) {
+                prev = cur;
+                if (++cur == mmap.upper_bound(key)) {
+                    found = prev->second;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+};
+
+
+static const long LookupsPerSize = 2000000;
+
+static double Now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Function: Time
+ * --------------
+ * Fills a new Table with keys, over and over until that has taken long
+ * enough to time, then looks up each of the keys, and each of misses,
+ * as many times over as makes about LookupsPerSize lookups in all.
+ */
+template <class Table> static void Time(const char *name, const std::vector<const char*> &keys,
+                                        const std::vector<const char*> &misses) {
+    int n = keys.size();
+    long reps = LookupsPerSize / n + 1, rounds = 0, found = 0;
+    double t0 = Now();
+    do {
+        Table *table = new Table;
+        for (int i = 0; i < n; i++)
+            table->Enter(keys[i], keys[i]);
+        delete table;
+        rounds++;
+    } while (Now() - t0 < 0.1 && rounds * n < LookupsPerSize / 20);
+    double entered = Now() - t0;
+
+    Table *table = new Table;
+    for (int i = 0; i < n; i++)
+        table->Enter(keys[i], keys[i]);
+    double t1 = Now();
+    for (long r = 0; r < reps; r++)
+        for (int i = 0; i < n; i++)
+            found += table->Lookup(keys[i]) != NULL;
+    double t2 = Now();
+    for (long r = 0; r < reps; r++)
+        for (int i = 0; i < n; i++)
+            found += table->Lookup(misses[i]) != NULL;
+    double t3 = Now();
+    delete table;
+    if (found != reps * n)
+        Failure("%s lost keys at size %d", name, n);
+    printf("%-9s %7d: enter %7.1f ns, lookup %7.1f ns, miss %7.1f ns\n", name, n,
+           entered * 1e9 / (rounds * n), (t2 - t1) * 1e9 / (reps * n),
+           (t3 - t2) * 1e9 / (reps * n));
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(atoi(argv[i]));
+    if (sizes.empty()) {
+        sizes.push_back(10);
+        sizes.push_back(1000);
+        sizes.push_back(100000);
+    }
+    for (size_t s = 0; s < sizes.size(); s++) {
+        std::vector<const char*> keys, misses;
+        char buf[32];
+        for (int i = 0; i < sizes[s]; i++) {
+            snprintf(buf, sizeof(buf), "name%d", i);
+            keys.push_back(Intern(buf));
+            snprintf(buf, sizeof(buf), "other%d", i);
+            misses.push_back(Intern(buf));
+        }
+        Time<MultimapTable<const char*> >("multimap", keys, misses);
+        Time<Hashtable<const char*> >("Hashtable", keys, misses);
+    }
+    return 0;
+}
@@ -1,11 +1,28 @@
+#include <string.h>
 #include "ast_type.h"
 #include "inheritance_hierarchy.h"
 #include "hashtable.h"
 #include "list.h"
 
+/* Function: IsSubClassOf
+ * ----------------------
+ * Whether derived is base or extends it, directly or not. Classes are
+ * known by name; in a program that declares a name twice, every class
+ * of that name counts as base.
+ */
 bool InheritanceHierarchy::IsSubClassOf(Type *base, Type *derived) {
     Link *l = hierarchy->Lookup(derived->getName());
 
+    if (frozen) {
+        if (l == NULL || !isa<NamedType>(base))
+            return false;
+        for (Link *b = hierarchy->Lookup(base->getName()); b; b = b->sameName) {
+            if (b->pre <= l->pre && l->pre < b->post)
+                return true;
+        }
+        return false;
+    }
+
     while (l) {
         if (l->type->IsEquivalentTo(base)) {
             return true;
@@ -15,29 +32,119 @@ bool InheritanceHierarchy::IsSubClassOf(Type *base, Type *derived) {
     return false;
 }
 
+/* Function: IsInterfaceOf
+ * -----------------------
+ * Whether derived or one of its superclasses says it implements
+ * interface.
+ */
 bool InheritanceHierarchy::IsInterfaceOf(Type *interface, Type *derived) {
     Link *l = hierarchy->Lookup(derived->getName());
 
-    if (l == NULL) return false;
+    if (frozen) {
+        if (l == NULL || !isa<NamedType>(interface))
+            return false;
+        Interface *i = interfaces->Lookup(interface->getName());
+        return i && (l->interfaceBits[i->bit / BitsPerWord] >> (i->bit % BitsPerWord) & 1);
+    }
 
-    for (int i = 0; i < l->Interfaces->NumElements(); i++) {
-        if (interface->IsEquivalentTo(l->Interfaces->Nth(i))) {
-            return true;
+    while (l) {
+        for (int i = 0; i < l->Interfaces->NumElements(); i++) {
+            if (interface->IsEquivalentTo(l->Interfaces->Nth(i))) {
+                return true;
+            }
         }
+        l = l->Parent;
     }
-    if (l->Parent) return IsInterfaceOf(interface, l->Parent->type);
     return false;
 }
 
 void InheritanceHierarchy::AddClassInheritance(Type *base, Type* derived, List<NamedType*> *interfaces) {
+    Assert(!frozen);
     Link *l = new Link();
     l->type = derived;
     l->Interfaces = interfaces;
     l->Parent = base ? hierarchy->Lookup(base->getName()) : NULL;
+    l->sameName = hierarchy->Lookup(derived->getName());
+    l->firstChild = l->nextSibling = l->nextToVisit = NULL;
+    l->pre = l->post = 0;
+    l->interfaceBits = NULL;
     hierarchy->Enter(derived->getName(), l);
-    
+    links->Append(l);
+}
+
+/* Function: Freeze
+ * ----------------
+ * Numbers the links depth first and works out their interface bits.
+ * A link is always added after its parent, so the links are in an
+ * order where parents come first, and each can start from its parent's
+ * bits. The walk follows the parent links back up instead of keeping a
+ * stack, so a deep hierarchy takes no more C stack than a shallow one.
+ */
+void InheritanceHierarchy::Freeze() {
+    Assert(!frozen);
+    frozen = true;
+    int numLinks = links->NumElements();
+
+    int numInterfaces = 0;
+    for (int k = 0; k < numLinks; k++) {
+        List<NamedType*> *implements = links->Nth(k)->Interfaces;
+        for (int i = 0; i < implements->NumElements(); i++) {
+            const char *name = implements->Nth(i)->getName();
+            if (interfaces->Lookup(name) == NULL) {
+                Interface *in = new Interface;
+                in->bit = numInterfaces++;
+                interfaces->Enter(name, in);
+            }
+        }
+    }
+    int numWords = (numInterfaces + BitsPerWord - 1) / BitsPerWord;
+
+    unsigned long *noBits = (unsigned long *)ArenaAlloc((numWords + 1) * sizeof(unsigned long));
+    memset(noBits, 0, (numWords + 1) * sizeof(unsigned long));
+    for (int k = 0; k < numLinks; k++) {
+        Link *l = links->Nth(k);
+        if (l->Interfaces->NumElements() == 0) {
+            // the same as the parent's, so shared with it
+            l->interfaceBits = l->Parent ? l->Parent->interfaceBits : noBits;
+        } else {
+            l->interfaceBits = (unsigned long *)ArenaAlloc(numWords * sizeof(unsigned long));
+            memcpy(l->interfaceBits, l->Parent ? l->Parent->interfaceBits : noBits,
+                   numWords * sizeof(unsigned long));
+            for (int i = 0; i < l->Interfaces->NumElements(); i++) {
+                int bit = interfaces->Lookup(l->Interfaces->Nth(i)->getName())->bit;
+                l->interfaceBits[bit / BitsPerWord] |= 1UL << (bit % BitsPerWord);
+            }
+        }
+        if (l->Parent) {
+            l->nextSibling = l->Parent->firstChild;
+            l->Parent->firstChild = l;
+        }
+    }
+
+    int count = 0;
+    for (int k = 0; k < numLinks; k++) {
+        Link *l = links->Nth(k);
+        if (l->Parent)
+            continue;
+        l->pre = count++;
+        l->nextToVisit = l->firstChild;
+        while (l) {
+            if (Link *child = l->nextToVisit) {
+                l->nextToVisit = child->nextSibling;
+                child->pre = count++;
+                child->nextToVisit = child->firstChild;
+                l = child;
+            } else {
+                l->post = count;
+                l = l->Parent;
+            }
+        }
+    }
 }
 
 InheritanceHierarchy::InheritanceHierarchy() {
     hierarchy = new Hashtable<Link*>();
+    links = new List<Link*>;
+    interfaces = new Hashtable<Interface*>;
+    frozen = false;
 }
\ No newline at end of file
@@ -1,25 +1,67 @@
 #ifndef _INHERITANCE_HIERARCHY_H
 #define _INHERITANCE_HIERARCHY_H
 
+#include "arena.h"
 #include "hashtable.h"
 #include "list.h"
 
 class Type;
 
+/* Class: InheritanceHierarchy
+ * ---------------------------
+ * The classes and what they extend and implement, as added by
+ * ClassDecl::FinishInheritance, for the subclass and interface tests of
+ * NamedType::IsConvertableTo. Until Freeze is called the tests walk up
+ * the superclass links. Freeze numbers the classes in a depth-first walk
+ * of the class trees, so that the subclasses of a class are exactly the
+ * ones numbered within its interval [pre, post), and gives each class a
+ * set of bits for the interfaces it or any superclass implements. After
+ * that both tests take constant time, and no more classes can be added.
+ * The frozen hierarchy is only read, so it can be shared by the threads
+ * checking functions (see Program::CheckFunctions).
+ */
 class InheritanceHierarchy {
 private:
     struct Link {
         Type *type;
         Link *Parent;
         List<NamedType*> *Interfaces;
+        Link *sameName;             // class entered before under the same name
+        Link *firstChild, *nextSibling, *nextToVisit;  // used by Freeze
+        int pre, post;              // depth-first numbering, set by Freeze
+        unsigned long *interfaceBits;   // set by Freeze, see Interface
+
+        static void *operator new(size_t size) { return ArenaAlloc(size); }
+        static void operator delete(void *p) {}
+    };
+
+    // An interface named in some class's implements list, and its bit
+    struct Interface {
+        int bit;
+
+        static void *operator new(size_t size) { return ArenaAlloc(size); }
+        static void operator delete(void *p) {}
     };
 
     Hashtable<Link*> * hierarchy;
+    List<Link*> *links;             // every link, in the order added
+    Hashtable<Interface*> *interfaces;  // set by Freeze
+    bool frozen;
+
+    static const int BitsPerWord = 8 * sizeof(unsigned long);
 public:
     InheritanceHierarchy();
+
+    // Lives in the compilation arena, as do its links
+    static void *operator new(size_t size) { return ArenaAlloc(size); }
+    static void operator delete(void *p) {}
+
     bool IsSubClassOf(Type *base, Type *derived);
     bool IsInterfaceOf(Type *interface, Type *derived);
     void AddClassInheritance(Type *base, Type* derived, List<NamedType*> *interfaces);
+
+    // Call once every class has been added
+    void Freeze();
 };
 
 #endif
\ No newline at end of file
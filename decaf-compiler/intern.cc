@@ -0,0 +1,113 @@
+/* File: intern.cc
+ * ---------------
+ * Implementation of the identifier interning table.
+ *
+ * The table is split into NumShards shards selected by the top bits of
+ * the hash, each with its own lock, so threads interning different names
+ * rarely contend. A shard is an open-addressing (linear probing) array of
+ * pointers to interned names. Each name is stored in the shard's string
+ * storage right after a small header holding its hash and length, which
+ * is where InternedHash and InternedLength look for them.
+ */
+
+#include "intern.h"
+#include "utility.h"
+#include <stdlib.h>
+#include <mutex>
+
+struct NameHeader {
+    unsigned hash;
+    unsigned len;
+};
+
+struct Shard {
+    std::mutex lock;
+    const char **slots;
+    unsigned capacity, count;   // capacity is always a power of 2
+    char *chunk, *chunkEnd;     // string storage being filled
+};
+
+static const int ShardBits = 6;
+static const int NumShards = 1 << ShardBits;
+static const unsigned ChunkSize = 16 * 1024;
+
+static Shard shards[NumShards];
+
+
+/* Function: HashName
+ * ------------------
+ * 32-bit FNV-1a. Names are short, so this is hard to beat.
+ */
+static unsigned HashName(const char *s, int len)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void Grow(Shard *sh)
+{
+    unsigned newCap = sh->capacity ? sh->capacity * 2 : 256;
+    const char **newSlots = (const char **)calloc(newCap, sizeof(const char *));
+    if (!newSlots) Failure("Out of memory growing name table");
+    for (unsigned i = 0; i < sh->capacity; i++) {
+        const char *name = sh->slots[i];
+        if (!name) continue;
+        unsigned j = InternedHash(name) & (newCap - 1);
+        while (newSlots[j]) j = (j + 1) & (newCap - 1);
+        newSlots[j] = name;
+    }
+    free(sh->slots);
+    sh->slots = newSlots;
+    sh->capacity = newCap;
+}
+
+static const char *Store(Shard *sh, const char *s, int len, unsigned hash)
+{
+    size_t need = sizeof(NameHeader) + len + 1;
+    need = (need + sizeof(NameHeader) - 1) & ~(sizeof(NameHeader) - 1);  // keep headers aligned
+    if (need > (size_t)(sh->chunkEnd - sh->chunk)) {
+        size_t size = need > ChunkSize ? need : ChunkSize;
+        sh->chunk = (char *)malloc(size);   // never freed, names live for the whole process
+        if (!sh->chunk) Failure("Out of memory storing names");
+        sh->chunkEnd = sh->chunk + size;
+    }
+    NameHeader *h = (NameHeader *)sh->chunk;
+    h->hash = hash;
+    h->len = len;
+    char *name = (char *)(h + 1);
+    memcpy(name, s, len);
+    name[len] = '\0';
+    sh->chunk += need;
+    return name;
+}
+
+const char *Intern(const char *s, int len)
+{
+    unsigned hash = HashName(s, len);
+    Shard *sh = &shards[hash >> (32 - ShardBits)];
+    std::lock_guard<std::mutex> guard(sh->lock);
+
+    if (sh->capacity) {
+        unsigned mask = sh->capacity - 1;
+        for (unsigned i = hash & mask; sh->slots[i]; i = (i + 1) & mask) {
+            const char *name = sh->slots[i];
+            if (InternedHash(name) == hash && InternedLength(name) == len &&
+                memcmp(name, s, len) == 0)
+                return name;
+        }
+    }
+
+    if (2 * (sh->count + 1) > sh->capacity)  // keep load at most 1/2
+        Grow(sh);
+    const char *name = Store(sh, s, len, hash);
+    unsigned mask = sh->capacity - 1;
+    unsigned i = hash & mask;
+    while (sh->slots[i]) i = (i + 1) & mask;
+    sh->slots[i] = name;
+    sh->count++;
+    return name;
+}
@@ -0,0 +1,35 @@
+/* File: intern.h
+ * --------------
+ * Identifier interning. Every distinct name seen by the compiler is
+ * stored exactly once, and Intern() hands back the same pointer every
+ * time it is asked for the same characters. Two interned names are
+ * therefore equal exactly when the pointers are equal, so comparing
+ * names is a pointer compare instead of a strcmp.
+ *
+ * Interned names are ordinary NUL-terminated strings and can be
+ * printed or strcmp'd as usual. Each also carries its hash and length,
+ * computed once when it was first interned.
+ *
+ * The table is shared by the whole process and outlives any single
+ * compilation. It is safe to intern from several threads at once (the
+ * table is split into independently locked shards), so scanners
+ * running in parallel can share it.
+ */
+
+#ifndef _H_intern
+#define _H_intern
+
+#include <string.h>
+
+          // Returns the unique interned copy of the first len chars of s
+const char *Intern(const char *s, int len);
+
+          // Same as above, for a NUL-terminated string
+inline const char *Intern(const char *s) { return Intern(s, strlen(s)); }
+
+          // The hash and length recorded for a name returned by Intern.
+          // Only valid on interned names.
+inline unsigned InternedHash(const char *name) { return ((const unsigned *)name)[-2]; }
+inline int InternedLength(const char *name)    { return ((const unsigned *)name)[-1]; }
+
+#endif
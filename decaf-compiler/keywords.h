@@ -0,0 +1,102 @@
+/* File: keywords.h
+ * ----------------
+ * Keyword recognition for both scanners. Keywords (and the constants
+ * true and false) are scanned as identifiers and then looked up here,
+ * instead of each being a rule of its own, which keeps them out of the
+ * flex DFA.
+ *
+ * The lookup is a perfect hash: the first and last characters and the
+ * length of a word are packed into a key, multiplied by a constant and
+ * the top bits taken as the slot. The constant is found by the compiler
+ * (FindKeywordHash is constexpr), trying multipliers in turn until one
+ * sends every keyword to a slot of its own, so adding a keyword needs
+ * no hand tuning. A lookup is then one multiply, one table load, and a
+ * compare against the single keyword that could be there.
+ */
+
+#ifndef _H_keywords
+#define _H_keywords
+
+#include <string.h>
+#include "parser.h" // for token codes
+
+struct Keyword {
+    const char *word;
+    int token;
+};
+
+constexpr Keyword keywords[] = {
+    {"void", T_Void}, {"int", T_Int}, {"double", T_Double}, {"bool", T_Bool},
+    {"string", T_String}, {"null", T_Null}, {"class", T_Class},
+    {"extends", T_Extends}, {"this", T_This}, {"interface", T_Interface},
+    {"implements", T_Implements}, {"while", T_While}, {"for", T_For},
+    {"if", T_If}, {"else", T_Else}, {"return", T_Return}, {"break", T_Break},
+    {"New", T_New}, {"NewArray", T_NewArray}, {"Print", T_Print},
+    {"ReadInteger", T_ReadInteger}, {"ReadLine", T_ReadLine},
+    {"true", T_BoolConstant}, {"false", T_BoolConstant},
+};
+
+const int NumKeywords = sizeof(keywords) / sizeof(keywords[0]);
+const int KeywordSlotBits = 6;
+const int NumKeywordSlots = 1 << KeywordSlotBits;
+
+constexpr int KeywordLength(const char *word) {
+    int len = 0;
+    while (word[len] != '\0') len++;
+    return len;
+}
+
+constexpr unsigned KeywordKey(const char *s, int len) {
+    return (unsigned char)s[0] << 16 | (unsigned char)s[len-1] << 8 | (unsigned char)len;
+}
+
+constexpr unsigned KeywordSlot(unsigned key, unsigned multiplier) {
+    return (key * multiplier) >> (32 - KeywordSlotBits);
+}
+
+struct KeywordHash {
+    unsigned multiplier;
+    signed char slots[NumKeywordSlots];   // index into keywords, -1 if empty
+};
+
+/* Function: FindKeywordHash
+ * -------------------------
+ * Tries multiples of the golden-ratio constant until one puts every
+ * keyword in a different slot. Evaluated by the compiler; it fails to
+ * compile (by running off the end of the search) if none does.
+ */
+constexpr KeywordHash FindKeywordHash() {
+    for (unsigned i = 1; i < 4096; i++) {
+        KeywordHash h = {i * 2654435761u, {}};
+        for (int s = 0; s < NumKeywordSlots; s++)
+            h.slots[s] = -1;
+        bool perfect = true;
+        for (int k = 0; k < NumKeywords && perfect; k++) {
+            const char *w = keywords[k].word;
+            unsigned slot = KeywordSlot(KeywordKey(w, KeywordLength(w)), h.multiplier);
+            if (h.slots[slot] != -1)
+                perfect = false;
+            h.slots[slot] = k;
+        }
+        if (perfect)
+            return h;
+    }
+    throw "no perfect hash for the keywords";
+}
+
+constexpr KeywordHash keywordHash = FindKeywordHash();
+
+
+/* Function: KeywordToken
+ * ----------------------
+ * Returns the token code for the len characters at s if they spell a
+ * keyword, true or false (T_BoolConstant), and 0 otherwise.
+ */
+inline int KeywordToken(const char *s, int len) {
+    int k = keywordHash.slots[KeywordSlot(KeywordKey(s, len), keywordHash.multiplier)];
+    if (k < 0 || strncmp(keywords[k].word, s, len) != 0 || keywords[k].word[len] != '\0')
+        return 0;
+    return keywords[k].token;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Checks that the hand-written scanner (-fhand-scanner) and the flex one
+# agree: for every sample, the two must print the same tokens, values
+# and locations (-d tokens) and the same errors. Run with -l to see the
+# differences for the files that fail.
+
+#make
+
+first() {
+    ./dcc -d lexonly tokens < "$1"
+}
+
+second() {
+    ./dcc -fhand-scanner -d lexonly tokens < "$1"
+}
+
+agree="Scanners Agree"
+source "$(dirname "$0")/compare.bash"
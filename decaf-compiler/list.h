@@ -2,10 +2,12 @@
  * ------------
  * Simple list class for storing a linear collection of elements. It
  * supports operations similar in name to the CS107 DArray -- nth, insert,
- * append, remove, etc.  This class is nothing more than a very thin
- * cover of a STL deque, with some added range-checking. Given not everyone
- * is familiar with the C++ templates, this class provides a more familiar
- * interface.
+ * append, remove, etc.  It is a growable array: elements are stored
+ * contiguously, and the first few are stored inside the List object
+ * itself, so the short lists that make up most of the parse tree
+ * (formals, actuals, one-statement blocks) need no storage of their own.
+ * Given not everyone is familiar with the C++ templates, this class
+ * provides a more familiar interface.
  *
  * It can handle elements of any type, the typename for a List includes the
  * element type in angle brackets, e.g.  to store elements of type double,
@@ -23,63 +25,174 @@
  *       }
  *       return sum;
  *    }
+ *
+ * or, equivalently, with a range-based for loop:
+ *
+ *       for (int val : *list)
+ *          sum += val;
+ *
+ * Index checks are done with ListAssert, which is compiled out when
+ * NDEBUG is defined.
  */
 
 #ifndef _H_list
 #define _H_list
 
-#include <deque>
+#include <new>
+#include <utility>
+#include "arena.h"
 #include "utility.h"  // for Assert()
 #include "errors.h"
 
+#ifdef NDEBUG
+#define ListAssert(expr) ((void)0)
+#else
+#define ListAssert(expr) Assert(expr)
+#endif
+
 class EnvVector;
 class Node;
 
 template<class Element> class List {
 
  private:
-    std::deque<Element> elems;
+    static const int InlineCapacity = 3;
+
+    Element *elems;           // points at inlineElems until it outgrows them
+    int numElems, capacity;
+    Arena *arena;             // where grown storage comes from, NULL for heap
+    union { char inlineBytes[InlineCapacity * sizeof(Element)]; double align; };
+
+    Element *InlineElems() { return (Element *)inlineBytes; }
+    bool IsInline() const  { return elems == (const Element *)inlineBytes; }
+
+    void Grow(int minCapacity)
+    { int newCapacity = capacity * 2 > minCapacity ? capacity * 2 : minCapacity;
+      Element *e = (Element *)(arena ? arena->Alloc(newCapacity * sizeof(Element))
+                                     : ::operator new(newCapacity * sizeof(Element)));
+      for (int i = 0; i < numElems; i++) {
+          new (e + i) Element(std::move(elems[i]));
+          elems[i].~Element();
+      }
+      FreeStorage();
+      elems = e;
+      capacity = newCapacity; }
+
+    void FreeStorage()
+    { if (!IsInline() && !arena) ::operator delete(elems); }
+
+    void Init()
+    { elems = InlineElems(); numElems = 0; capacity = InlineCapacity;
+      arena = Arena::Active(); }
 
  public:
            // Create a new empty list
-    List() {}
+    List() { Init(); }
+
+    List(const List &other)
+    { Init(); Reserve(other.numElems);
+      for (int i = 0; i < other.numElems; i++) Append(other.elems[i]); }
+
+          // Moving a list takes over its storage when it has any,
+          // leaving the other list empty
+    List(List &&other) { Init(); *this = std::move(other); }
+
+    ~List() { Clear(); FreeStorage(); }
+
+    List &operator=(const List &other)
+    { if (this != &other) {
+          Clear(); Reserve(other.numElems);
+          for (int i = 0; i < other.numElems; i++) Append(other.elems[i]);
+      }
+      return *this; }
+
+    List &operator=(List &&other)
+    { if (this == &other) return *this;
+      Clear();
+      if (other.IsInline() || other.arena != arena) {
+          Reserve(other.numElems);
+          for (int i = 0; i < other.numElems; i++) Append(std::move(other.elems[i]));
+          other.Clear();
+      } else {
+          FreeStorage();
+          elems = other.elems; numElems = other.numElems; capacity = other.capacity;
+          other.elems = other.InlineElems(); other.numElems = 0;
+          other.capacity = InlineCapacity;
+      }
+      return *this; }
+
+           // Lists made with new live in the compilation arena, as
+           // does the storage of any list created while it is active
+    static void *operator new(size_t size) { return ArenaAlloc(size); }
+    static void operator delete(void *p) {}
 
            // Returns count of elements currently in list
     int NumElements() const
-	{ return elems.size(); }
+	{ return numElems; }
 
           // Returns element at index in list. Indexing is 0-based.
           // Raises an assert if index is out of range.
     Element Nth(int index) const
-	{ Assert(index >= 0 && index < NumElements());
+	{ ListAssert(index >= 0 && index < NumElements());
 	  return elems[index]; }
 
+          // Makes room for at least n elements without further growth
+    void Reserve(int n)
+	{ if (n > capacity) Grow(n); }
+
           // Inserts element at index, shuffling over others
           // Raises assert if index out of range
     void InsertAt(const Element &elem, int index)
-	{ Assert(index >= 0 && index <= NumElements());
-	  elems.insert(elems.begin() + index, elem); }
+	{ ListAssert(index >= 0 && index <= NumElements());
+	  Element copy(elem);  // elem may live in this list
+	  if (numElems == capacity) Grow(numElems + 1);
+	  new (elems + numElems) Element(std::move(copy));
+	  for (int i = numElems; i > index; i--)
+	      std::swap(elems[i], elems[i-1]);
+	  numElems++; }
 
           // Adds element to list end
     void Append(const Element &elem)
-	{ elems.push_back(elem); }
+	{ if (numElems == capacity) { Element copy(elem); Grow(numElems + 1);
+	                              new (elems + numElems++) Element(std::move(copy)); }
+	  else new (elems + numElems++) Element(elem); }
+
+    void Append(Element &&elem)
+	{ if (numElems == capacity) Grow(numElems + 1);
+	  new (elems + numElems++) Element(std::move(elem)); }
 
          // Removes element at index, shuffling down others
          // Raises assert if index out of range
     void RemoveAt(int index)
-	{ Assert(index >= 0 && index < NumElements());
-	  elems.erase(elems.begin() + index); }
-          
+	{ ListAssert(index >= 0 && index < NumElements());
+	  for (int i = index; i < numElems - 1; i++)
+	      elems[i] = std::move(elems[i+1]);
+	  elems[--numElems].~Element(); }
+
+         // Removes all elements, keeping the storage
+    void Clear()
+	{ for (int i = 0; i < numElems; i++) elems[i].~Element();
+	  numElems = 0; }
+
+         // For range-based for loops
+    Element *begin()             { return elems; }
+    Element *end()               { return elems + numElems; }
+    const Element *begin() const { return elems; }
+    const Element *end() const   { return elems + numElems; }
+
        // These are some specific methods useful for lists of ast nodes
        // They will only work on lists of elements that respond to the
        // messages, but since C++ only instantiates the template if you use
-       // you can still have Lists of ints, chars*, as long as you 
+       // you can still have Lists of ints, chars*, as long as you
        // don't try to SetParentAll on that list.
     void SetParentAll(Node *p)
         { for (int i = 0; i < NumElements(); i++)
              Nth(i)->SetParent(p); }
 
+    void PrintAll(int indentLevel, const char *label = NULL)
+        { for (int i = 0; i < NumElements(); i++)
+             Nth(i)->Print(indentLevel, label); }
+
 };
 
 #endif
-
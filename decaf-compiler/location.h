@@ -2,37 +2,38 @@
  * ----------------
  * This file just contains features relative to the location structure
  * used to record the lexical position of a token or symbol.  This file
- * establishes the cmoon definition for the yyltype structure, the global
- * variable yylloc, and a utility function to join locations you might
- * find handy at times.
+ * establishes the cmoon definition for the yyltype structure and a
+ * utility function to join locations you might find handy at times.
  */
 
 #ifndef YYLTYPE
 
+/* Typedef: SourcePos
+ * ------------------
+ * A position in the source is just the byte offset of a character from
+ * the start of the input. Line and column numbers are not stored, they
+ * are recovered from the scanner's line-start table (see GetLineForPos
+ * and GetColumnForPos in scanner.h) when an error message needs them.
+ */
+typedef unsigned int SourcePos;
+
+const SourcePos NoPos = (SourcePos)-1;
+
 /* Typedef: yyltype
  * ----------------
  * Defines the struct type that is used by the scanner to store
- * position information about each lexeme scanned.
+ * position information about each lexeme scanned: the positions of
+ * its first and last characters, inclusive.  At 8 bytes it is small
+ * enough to be stored inline in every node and passed by value.
  */
 typedef struct yyltype
 {
-    int timestamp;                 // you can ignore this field
-    int first_line, first_column;
-    int last_line, last_column;      
-    char *text;                    // you can also ignore this field
+    SourcePos first, last;
 } yyltype;
 
 #define YYLTYPE yyltype
 
 
-/* Global variable: yylloc
- * ------------------------
- * The global variable holding the position information about the
- * lexeme just scanned.
- */
-extern struct yyltype yylloc;
-
-
 /* Function: Join
  * --------------
  * Takes two locations and returns a new location which represents
@@ -41,10 +42,8 @@ extern struct yyltype yylloc;
 inline yyltype Join(yyltype first, yyltype last)
 {
   yyltype combined;
-  combined.first_column = first.first_column;
-  combined.first_line = first.first_line;
-  combined.last_column = last.last_column;
-  combined.last_line = last.last_line;
+  combined.first = first.first;
+  combined.last = last.last;
   return combined;
 }
 
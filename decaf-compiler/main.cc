@@ -6,26 +6,94 @@
  
 #include <string.h>
 #include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "arena.h"
+#include "compilation.h"
+
+
+/* Function: ReportArenaStats()
+ * ----------------------------
+ * Prints allocation counters, elapsed time and peak resident set size
+ * when the "arena" debug key is on. Running once with -d arena and once
+ * with -d arena noarena (everything from the heap, as before the arena
+ * was introduced) shows what the arena saves on a given input.
+ */
+static void ReportArenaStats(const Arena &arena, const struct timeval &start)
+{
+    if (!IsDebugOn("arena"))
+        return;
+
+    struct timeval now;
+    struct rusage usage;
+    gettimeofday(&now, NULL);
+    getrusage(RUSAGE_SELF, &usage);
+    double elapsed = (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+
+    if (IsDebugOn("noarena"))
+        PrintDebug("arena", "arena disabled, all allocations from the heap");
+    else
+        PrintDebug("arena", "%lu allocations, %lu bytes in %d blocks (%lu reserved)",
+                   (unsigned long)arena.NumAllocs(), (unsigned long)arena.BytesAllocated(),
+                   arena.NumBlocks(), (unsigned long)arena.BytesReserved());
+    PrintDebug("arena", "%.3f s elapsed, peak RSS %ld KB", elapsed, usage.ru_maxrss);
+}
+
+
+/* Function: LexOnly()
+ * --------------------
+ * Runs the scanner over the whole input without parsing, for timing the
+ * scanner on its own: -d lexonly arena prints the token count and then
+ * the usual time and memory figures.
+ */
+static void LexOnly(Compilation *comp)
+{
+    YYSTYPE lval;
+    yyltype lloc;
+    int tokens = 0;
+    while (yylex(&lval, &lloc, comp) != 0)
+        tokens++;
+    PrintDebug("lexonly", "%d tokens", tokens);
+}
 
 
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * ReadSource() is used to bring in the named file, or standard input if
+ * no file was given, and a Compilation is set up to compile it.
+ * InitParser() is used to set up the parser. The call to Run() will
+ * attempt to parse a complete program from the input (and with
+ * -fsyntax-only, do no more than that, always with the hand-written
+ * parser).
+ * Everything built along the way lives in the compilation's arena, which
+ * is released in one shot once we are done.
  */
 int main(int argc, char *argv[])
 {
-    ParseCommandLine(argc, argv);
-  
-    InitScanner();
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    Options options;
+    const char *file = ParseCommandLine(argc, argv, &options);
+
+    size_t length;
+    char *text = ReadSource(file, &length);
+    if (text == NULL) {
+        fprintf(stderr, "dcc: cannot read %s\n", file);
+        return 2;
+    }
     InitParser();
-    yyparse();
-    return (ReportError::NumErrors() == 0? 0 : -1);
-}
+    Compilation comp(text, length, std::cerr, options);
+    comp.Activate();
+    if (IsDebugOn("lexonly"))
+        LexOnly(&comp);
+    else
+        comp.Run();
 
+    ReportArenaStats(comp.arena, start);
+    return (comp.numErrors == 0? 0 : -1);
+}
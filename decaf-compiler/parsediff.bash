@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Checks that the hand-written parser (-fhand-parser) and the bison one
+# agree: for every sample, the two must print the same tree, with the
+# same locations (-d ast), and the same errors, and exit the same way.
+# Run with -l to see the differences for the files that fail.
+
+#make
+
+first() {
+    ./dcc -d ast < "$1"
+    echo "exit $?"
+}
+
+second() {
+    ./dcc -fhand-parser -d ast < "$1"
+    echo "exit $?"
+}
+
+agree="Parsers Agree"
+source "$(dirname "$0")/compare.bash"
@@ -28,11 +28,14 @@
 // we are compiling y.tab.c, which we use the YYBISON symbol for. 
 // Managing C headers can be such a mess! 
 
+class Compilation;              // the parser's parameter, see compilation.h
+
 #ifndef YYBISON                 
 #include "y.tab.h"              
 #endif
 
-int yyparse();              // Defined in the generated y.tab.c file
+int yyparse(Compilation *comp); // Defined in the generated y.tab.c file
+int HandParse(Compilation *comp); // Same, by hand, in hand_parser.cc
 void InitParser();          // Defined in parser.y
 
 #endif
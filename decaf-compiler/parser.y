@@ -1,18 +1,69 @@
 /* File: parser.y
  * --------------
  * Yacc input file to generate the parser for the compiler.
+ *
+ * hand_parser.cc has a hand-written parser for the same grammar
+ * (-fhand-parser), which must build the same tree: change both together
+ * and run parsediff.bash.
  */
 
 %{
 
+#include <string.h>
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
 
-void yyerror(const char *msg); // standard error-handling routine
+void yyerror(yyltype *loc, Compilation *comp, const char *msg); // standard error-handling routine
+
+/* Our yyltype is just a pair of source positions (see location.h), so we
+ * replace bison's default, which expects line and column fields. The
+ * location of a rule spans its first to last symbol; an empty rule
+ * sits at the end of whatever preceded it.
+ */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                 \
+    do {                                                                \
+        if (N) {                                                        \
+            (Current).first = YYRHSLOC(Rhs, 1).first;                   \
+            (Current).last  = YYRHSLOC(Rhs, N).last;                    \
+        } else                                                          \
+            (Current).first = (Current).last = YYRHSLOC(Rhs, 0).last;   \
+    } while (0)
+
+/* The parser's stacks start out YYINITDEPTH deep on the C stack. When a
+ * program nests deeper than that, bison calls yyoverflow, which here
+ * moves them into the arena at twice the size, so however deeply a
+ * program nests, parsing it takes the same C stack. (Bison's own way of
+ * moving them is only used when YYLTYPE has its line and column
+ * fields.) The stacks only get as deep as the program nests, so what
+ * they take from the arena is bounded by the program's size.
+ */
+template <class T> T *GrowStack(T *stack, size_t bytesUsed, long newSize) {
+    T *grown = (T *)ArenaAlloc(newSize * sizeof(T));
+    memcpy(grown, stack, bytesUsed);
+    return grown;
+}
+
+#define yyoverflow(msg, ss, ssUsed, vs, vsUsed, ls, lsUsed, size)      \
+    do {                                                                \
+        *(size) *= 2;                                                   \
+        *(ss) = GrowStack(*(ss), ssUsed, *(size));                      \
+        *(vs) = GrowStack(*(vs), vsUsed, *(size));                      \
+        *(ls) = GrowStack(*(ls), lsUsed, *(size));                      \
+    } while (0)
 
 %}
 
+
+/* The parser is pure: yylval and yylloc are its own locals, handed to
+ * yylex on each call, and the compilation being parsed is passed down
+ * to the scanner, so several parses can be under way at once.
+ */
+%define api.pure full
+%locations
+%parse-param {Compilation *comp}
+%lex-param {Compilation *comp}
+
  
 /* yylval 
  * ------
@@ -20,9 +71,9 @@ void yyerror(const char *msg); // standard error-handling routine
 %union {
     int integerConstant;
     bool boolConstant;
-    char *stringConstant;
+    TokenText stringConstant;   // view into the input, see scanner.h
     double doubleConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    const char *identifier;     // interned, see intern.h
     Decl *decl;
     List<Decl*> *declList;
     Type *type;
@@ -98,6 +149,8 @@ void yyerror(const char *msg); // standard error-handling routine
 Program   :    DeclList            { 
                                       @1; 
                                       Program *program = new Program($1);
+                                      if (IsDebugOn("ast"))
+                                          program->Print(0);
                                       // if no errors, advance to next phase
                                       if (ReportError::NumErrors() == 0) 
                                           program->Check(); 
@@ -186,14 +239,15 @@ FnDecl    :    FnHeader StmtBlock   { ($$=$1)->SetFunctionBody($2); }
 
 StmtBlock :    '{' VarDecls StmtList '}' 
                                     { $$ = new StmtBlock($2, $3); }
+          |    '{' VarDecls '}'     { $$ = new StmtBlock($2, new List<Stmt*>); }
           ;
 
 VarDecls  :    VarDecls VarDecl     { ($$=$1)->Append($2); }
           |    /* empty */          { $$ = new List<VarDecl*>; }
           ;
 
-StmtList  :    Stmt StmtList        { $$ = $2; $$->InsertAt($1, 0); }
-          |    /* empty */          { $$ = new List<Stmt*>; }
+StmtList  :    StmtList Stmt        { ($$=$1)->Append($2); }
+          |    Stmt                 { ($$ = new List<Stmt*>)->Append($1); }
           ;
 
 Stmt      :    OptExpr ';'          { $$ = $1; }
@@ -264,7 +318,7 @@ Expr      :    LValue               { $$ = $1; }
 Constant  :    T_IntConstant        { $$ = new IntConstant(@1,$1); }
           |    T_BoolConstant       { $$ = new BoolConstant(@1,$1); }
           |    T_DoubleConstant     { $$ = new DoubleConstant(@1,$1); }
-          |    T_StringConstant     { $$ = new StringConstant(@1,$1); }
+          |    T_StringConstant     { $$ = new StringConstant(@1,$1.text,$1.length); }
           |    T_Null               { $$ = new NullConstant(@1); }
           ;
 
@@ -0,0 +1,57 @@
+/* File: scan_ahead.cc
+ * -------------------
+ * The deferred errors and tabs of scanning ahead, see scan_ahead.h.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "scan_ahead.h"
+#include "scanner.h"
+#include "errors.h"
+
+thread_local ScanSink *ScanSink::current = NULL;
+
+
+void ScanSink::DeferTab(SourcePos pos) {
+    Entry e;
+    memset(&e, 0, sizeof(e));
+    e.token = TabEntry;
+    e.loc.first = e.loc.last = pos;
+    Put(e);
+}
+
+void ScanSink::DeferError(yyltype *loc, const std::string &msg) {
+    Entry e;
+    memset(&e, 0, sizeof(e));
+    e.token = ErrorEntry;
+    if (loc)
+        e.loc = *loc;
+    else
+        e.loc.first = e.loc.last = NoPos;
+    char *text = (char *)malloc(msg.length());   // may hold a NUL
+    memcpy(text, msg.data(), msg.length());
+    e.value.stringConstant.text = text;
+    e.value.stringConstant.length = msg.length();
+    if (!Put(e))
+        free(text);
+}
+
+
+bool ScanSink::CarryOut(const Entry &e) {
+    if (e.token == TabEntry)
+        RecordTab(e.loc.first);
+    else if (e.token == ErrorEntry) {
+        TokenText msg = e.value.stringConstant;
+        yyltype loc = e.loc;
+        ReportError::OutputError(loc.first == NoPos ? NULL : &loc,
+                                 std::string(msg.text, msg.length));
+        free((char *)msg.text);
+    } else
+        return false;
+    return true;
+}
+
+void ScanSink::Discard(const Entry &e) {
+    if (e.token == ErrorEntry)
+        free((char *)e.value.stringConstant.text);
+}
@@ -0,0 +1,73 @@
+/* File: scan_ahead.h
+ * ------------------
+ * Scanning ahead of the parser. Normally the parser calls the scanner
+ * for each token it needs, on the parser's own thread. A ScanAhead
+ * instead has the program scanned on other threads, ahead of the
+ * parser, and hands the tokens over when the parser asks for them. There
+ * are two kinds: the TokenRing (token_ring.h), which scans the whole
+ * program on one thread while the parser runs, and the ChunkedScan
+ * (chunked_scan.h), which splits it up and scans the pieces at once.
+ *
+ * The scanners also report errors and record tab stops as they go, and
+ * both depend on (and change) state the parser's thread uses. On a
+ * scanning thread, those are not acted on but sent to the ScanSink the
+ * thread is filling, as entries of their own in order with the tokens,
+ * and carried out on the parser's thread when it reaches them. The
+ * output is the same, message for message, as when scanning inline.
+ */
+
+#ifndef _H_scan_ahead
+#define _H_scan_ahead
+
+#include <string>
+#include "location.h"
+#include "parser.h" // for YYSTYPE
+
+class ScanAhead
+{
+  public:
+    virtual ~ScanAhead() {}
+
+          // On the parser's thread: returns the next token, as yylex
+          // does, after carrying out any errors and tabs before it
+    virtual int Next(YYSTYPE *lval, yyltype *lloc) = 0;
+};
+
+
+class ScanSink
+{
+  public:
+    struct Entry {
+        int token;              // or one of the kinds below
+        yyltype loc;
+        YYSTYPE value;
+    };
+
+    enum { TabEntry = -1,       // RecordTab(loc.first)
+           ErrorEntry = -2 };   // an error at loc (NoPos if none), the
+                                // message in value.stringConstant, malloced
+
+    virtual ~ScanSink() {}
+
+          // The sink being filled on the calling thread, NULL except on
+          // a scanning thread. The scanners' errors and tabs go through
+          // these there instead of being acted on.
+    static ScanSink *Current() { return current; }
+    void DeferTab(SourcePos pos);
+    void DeferError(yyltype *loc, const std::string &msg);
+
+          // On the parser's thread: carries out e if it is a tab or an
+          // error and returns true, returns false if it is a token
+    static bool CarryOut(const Entry &e);
+
+          // Frees what an entry that will never be carried out holds
+    static void Discard(const Entry &e);
+
+  protected:
+    static thread_local ScanSink *current;
+
+          // Adds an entry, returns false if it is not wanted any more
+    virtual bool Put(const Entry &e) = 0;
+};
+
+#endif
@@ -9,17 +9,53 @@
 #define _H_scanner
 
 #include <stdio.h>
+#include "location.h"
 
 #define MaxIdentLen 31    // Maximum length for identifiers
 
-extern char *yytext;      // Text of lexeme just scanned
+const int ScanPadding = 32; // NUL bytes after the end of the input buffer
 
-
-int yylex();              // Defined in the generated lex.yy.c file
-void yyrestart(FILE *fp); // ditto
-
-
-void InitScanner();                 // Defined in scanner.l user subroutines
-const char *GetLineNumbered(int n); // ditto
+/* Struct: TokenText
+ * -----------------
+ * The characters of a token as a view into the scanner's input buffer,
+ * which holds the whole program (see InitScanner) and stays put for
+ * the rest of the compile. The text is not NUL-terminated.
+ */
+struct TokenText {
+    const char *text;
+    int length;
+};
+
+class Compilation;
+class HandScanner;
+union YYSTYPE;
+
+                          // Reads the named file (standard input if NULL) into
+                          // memory followed by ScanPadding NUL bytes, see
+                          // InitScanner. Returns NULL if it cannot be read.
+char *ReadSource(const char *file, size_t *length);
+
+                          // Set up and tear down the scanners of a compilation
+void InitScanner(Compilation *comp);
+void EndScanner(Compilation *comp);
+
+                          // Returns the next token and sets *lval and *lloc
+                          // to its value and location
+int yylex(union YYSTYPE *lval, yyltype *lloc, Compilation *comp);
+
+                          // The same, straight from the scanner (flex or
+                          // hand-written) even when scanning ahead
+int ScanToken(union YYSTYPE *lval, yyltype *lloc, Compilation *comp);
+
+
+                          // These work on the active compilation
+TokenText GetLineNumbered(int n);   // Defined in scanner.l user subroutines
+int GetLineForPos(SourcePos pos);   // ditto
+int GetColumnForPos(SourcePos pos); // ditto
+void RecordTab(SourcePos pos);      // ditto
+
+                          // The hand-written scanner, in hand_scanner.cc
+HandScanner *InitHandScanner(const char *text, size_t first, size_t last);
+int HandScan(HandScanner *scanner, union YYSTYPE *lval, yyltype *lloc);
  
 #endif
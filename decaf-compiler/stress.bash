@@ -0,0 +1,174 @@
+#!/bin/bash
+
+# Compiles generated programs that are very large or very deeply nested,
+# each at a quarter, half and all of its full size, with the C stack held
+# to 1 MB (ulimit -s), through the bison parser and the hand-written one
+# (-fhand-parser). Every program is valid, so each run must finish with
+# no errors and without crashing, and doubling the size must not much
+# more than double the time. Run with -s to use a tenth of the sizes.
+#
+#   stmts N  : a block of N statements
+#   sum N    : 1 + 1 + ... + 1, N terms, nested to the left
+#   nest N   : 1 + (1 + (... (1))), N deep, nested to the right
+#   unary N  : !!...!true, N deep
+#   assign N : x = x = ... = 0, N deep
+#   chain N  : o.m().m()...m(), N calls, each on the one before it
+#   args N   : f(f(...f(1))), N calls, each an argument of the next
+#   classes N: N classes, each extending the one after it in the program
+#   blocks N : { { ... { x = 1; } ... } }, N blocks deep
+#   loops N  : if, while and for in turn, each the body of the one before,
+#             N deep inside a while, with an else (a break) for each if
+
+#make
+
+scale=1
+if [ "$1" = "-s" ]
+then
+    scale=10
+fi
+
+TIMEFORMAT=%3R
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+pass=0
+tests=0
+flag=false
+
+stmts() {
+    awk -v n=$1 'BEGIN { print "void main() { int x;"
+        for (k = 0; k < n; k++) print "x = x + " k ";"
+        print "}" }'
+}
+
+sum() {
+    awk -v n=$1 'BEGIN { printf "void main() { int x; x = 1"
+        for (k = 1; k < n; k++) printf " + 1"
+        print "; }" }'
+}
+
+nest() {
+    awk -v n=$1 'BEGIN { printf "void main() { int x; x = 1"
+        for (k = 1; k < n; k++) printf " + (1"
+        for (k = 1; k < n; k++) printf ")"
+        print "; }" }'
+}
+
+unary() {
+    awk -v n=$1 'BEGIN { printf "void main() { bool b; b = "
+        for (k = 0; k < n; k++) printf "!"
+        print "true; }" }'
+}
+
+assign() {
+    awk -v n=$1 'BEGIN { printf "void main() { int x; "
+        for (k = 0; k < n; k++) printf "x = "
+        print "0; }" }'
+}
+
+chain() {
+    awk -v n=$1 'BEGIN { print "class A { A m() { return this; } }"
+        printf "void main() { A o; o = New(A); o = o"
+        for (k = 0; k < n; k++) printf ".m()"
+        print "; }" }'
+}
+
+args() {
+    awk -v n=$1 'BEGIN { print "int f(int y) { return y; }"
+        printf "void main() { int x; x = "
+        for (k = 0; k < n; k++) printf "f("
+        printf "1"
+        for (k = 0; k < n; k++) printf ")"
+        print "; }" }'
+}
+
+blocks() {
+    awk -v n=$1 'BEGIN { printf "void main() { int x; "
+        for (k = 0; k < n; k++) printf "{ "
+        printf "x = 1; "
+        for (k = 0; k < n; k++) printf "} "
+        print "}" }'
+}
+
+loops() {
+    awk -v n=$1 'BEGIN { printf "void main() { int x; while (x < 1) "
+        for (k = 0; k < n; k++)
+            if (k % 3 == 0) printf "if (x < 1) "
+            else if (k % 3 == 1) printf "while (x < 1) "
+            else printf "for (x = 0; x < 1; x = x + 1) "
+        printf "x = 1;"
+        for (k = n - 1; k >= 0; k--)
+            if (k % 3 == 0) printf " else break;"
+        print " }" }'
+}
+
+classes() {
+    awk -v n=$1 'BEGIN {
+        for (k = n; k > 0; k--)
+            print "class C" k " extends C" k - 1 " { int f" k "; void M" k "() { f" k " = f" k - 1 "; } }"
+        print "class C0 { int f0; }"
+        print "void main() { C0 c; c = New(C" n "); }" }'
+}
+
+# Runs case $1 at sizes $2/4, $2/2 and $2 with each parser
+stress() {
+    for args in "" -fhand-parser
+    do
+        prev=""
+        for size in $(($2 / 4)) $(($2 / 2)) $2
+        do
+            tests=$((tests + 1))
+            file="$tmp/$1-$size.decaf"
+            $1 $size > "$file"
+            secs=$( { time bash -c 'ulimit -s 1024; exec "$@"' - \
+                          ./dcc "$file" $args > "$tmp/out" 2>&1
+                      echo $? > "$tmp/rc" ; } 2>&1 )
+            if [ "$(cat "$tmp/rc")" -ge 128 ]
+            then
+                rc=crashed
+            elif grep -q "\*\*\*" "$tmp/out"
+            then
+                rc=errors
+            else
+                rc=ok
+            fi
+            if [ "$rc" = ok ] && [ -n "$prev" ] &&
+               awk -v a=$prev -v b=$secs 'BEGIN { exit !(b > 0.2 && b > 3 * a) }'
+            then
+                rc=nonlinear
+            fi
+            prev=$secs
+            printf "%-20s %8d: %8s s, " "$1${args:+ $args}" $size $secs
+            if [ "$rc" = ok ]
+            then
+                echo -e "\e[92mok\e[39m"
+                pass=$((pass + 1))
+            else
+                echo -e "\e[91m$rc\e[39m"
+                flag=true
+            fi
+        done
+    done
+}
+
+stress stmts $((1000000 / scale))
+stress sum $((100000 / scale))
+stress nest $((100000 / scale))
+stress unary $((100000 / scale))
+stress assign $((100000 / scale))
+stress chain $((100000 / scale))
+stress args $((100000 / scale))
+stress classes $((10000 / scale))
+stress blocks $((100000 / scale))
+stress loops $((100000 / scale))
+
+if [ "$flag" = "true" ]
+then
+    echo -e "\e[91m***************************"
+    echo "$pass / $tests Stress Tests Passed"
+    echo "***************************"
+else
+    echo -e "\e[92m***************************"
+    echo "$pass / $tests Stress Tests Passed"
+    echo "***************************"
+fi
@@ -50,6 +50,7 @@ then
     echo -e "\e[91m***************************"
     echo "$pass / $tests Tests Passed"
     echo "***************************"
+    exit 1
 else
     echo -e "\e[92m***************************"
     echo "$pass / $tests Tests Passed"
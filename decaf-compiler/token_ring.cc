@@ -0,0 +1,116 @@
+/* File: token_ring.cc
+ * -------------------
+ * Implementation of the TokenRing, see token_ring.h.
+ */
+
+#include <string.h>
+#include "token_ring.h"
+#include "compilation.h"
+#include "scanner.h"
+#include "utility.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const int SpinLimit = 256;
+
+        // called while waiting for the other side of the ring, the
+        // spins-th time in a row
+static inline void Wait(int spins) {
+    if (spins >= SpinLimit)
+        std::this_thread::yield();
+#ifdef __SSE2__
+    else
+        _mm_pause();
+#endif
+}
+
+
+TokenRing::TokenRing(Compilation *c)
+    : head(0), tail(0), stop(false) {
+    comp = c;
+    cachedTail = cachedHead = 0;
+    done = false;
+    thread = std::thread(&TokenRing::Produce, this);
+}
+
+TokenRing::~TokenRing() {
+    stop.store(true, std::memory_order_relaxed);
+    thread.join();
+    for (unsigned h = head.load(); h != tail.load(); h++)
+        Discard(entries[h & (Capacity - 1)]);
+}
+
+
+/* TokenRing::Produce
+ * ------------------
+ * The scanning thread: scans the whole program into the ring, or until
+ * the reader no longer wants it. The entry is reused from one token to
+ * the next, as the parser reuses its yylval and yylloc, so what is left
+ * in it at the end of the input is the same as when scanning inline.
+ */
+void TokenRing::Produce() {
+    current = this;
+    Entry e;
+    memset(&e, 0, sizeof(e));
+    do {
+        e.token = ScanToken(&e.value, &e.loc, comp);
+    } while (Put(e) && e.token != 0);
+    current = NULL;
+}
+
+/* TokenRing::Put
+ * --------------
+ * Adds an entry, waiting for room if the ring is full. Returns false,
+ * without adding it, if the reader has finished, which is checked on
+ * every call: a reader that stops early (a Failure, or a compilation
+ * destroyed before the end of its input) does not leave the scanner
+ * running on to fill the ring first.
+ */
+bool TokenRing::Put(const Entry &e) {
+    if (stop.load(std::memory_order_relaxed))
+        return false;
+    unsigned t = tail.load(std::memory_order_relaxed);
+    for (int spins = 0; t - cachedHead == Capacity; spins++) {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (t - cachedHead < Capacity)
+            break;
+        if (stop.load(std::memory_order_relaxed))
+            return false;
+        Wait(spins);
+    }
+    entries[t & (Capacity - 1)] = e;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+
+/* TokenRing::Next
+ * ---------------
+ * Takes entries off the ring, waiting for the scanner if it is empty,
+ * until one is a token. The errors and tabs before it are carried out
+ * on the way, as the scanner would have done inline.
+ */
+int TokenRing::Next(YYSTYPE *lval, yyltype *lloc) {
+    if (done)
+        return 0;
+    for (;;) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        for (int spins = 0; h == cachedTail; spins++) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h != cachedTail)
+                break;
+            Wait(spins);
+        }
+        Entry e = entries[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+
+        if (!CarryOut(e)) {
+            *lval = e.value;
+            *lloc = e.loc;
+            done = (e.token == 0);
+            return e.token;
+        }
+    }
+}
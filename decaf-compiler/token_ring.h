@@ -0,0 +1,68 @@
+/* File: token_ring.h
+ * ------------------
+ * Pipelined scanning. Normally the parser calls the scanner for each
+ * token it needs, so the two take turns on one core. With -fscan-thread,
+ * a program of at least PipelineMinLength bytes is instead scanned on a
+ * thread of its own, which runs ahead of the parser and hands it the
+ * tokens, with their values and locations, through a TokenRing. Smaller programs are scanned inline as usual:
+ * they are over before a thread would have paid for itself.
+ *
+ * The ring is a fixed array of entries with one reader (the parser's
+ * thread) and one writer (the scanning thread). Each side owns one
+ * index and only reads the other's, so no locks are needed: the writer
+ * fills an entry and then publishes it by moving its index on (a
+ * release store), and the reader sees the entry once it sees the index
+ * (an acquire load). A side that finds the ring full or empty spins
+ * briefly and then yields until the other catches up.
+ *
+ * Errors and tabs are deferred through the ring, in order with the
+ * tokens, as described in scan_ahead.h.
+ */
+
+#ifndef _H_token_ring
+#define _H_token_ring
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "scan_ahead.h"
+
+class Compilation;
+
+const size_t PipelineMinLength = 1 << 20;   // bytes
+
+class TokenRing : public ScanAhead, private ScanSink
+{
+  private:
+    static const unsigned Capacity = 4096;      // a power of 2
+
+    Compilation *comp;
+    Entry entries[Capacity];
+
+    alignas(64) std::atomic<unsigned> head;    // next entry to read
+    unsigned cachedTail;        // reader's last look at tail
+    bool done;                  // reader has seen the end
+
+    alignas(64) std::atomic<unsigned> tail;    // next entry to write
+    unsigned cachedHead;        // writer's last look at head
+    std::atomic<bool> stop;     // reader is finished, writer should quit
+
+    std::thread thread;
+
+    void Produce();
+    bool Put(const Entry &e);
+
+    TokenRing(const TokenRing&);            // not copyable
+    TokenRing &operator=(const TokenRing&);
+
+  public:
+          // Scans comp's program on a new thread
+    TokenRing(Compilation *comp);
+    ~TokenRing();
+
+          // On the parser's thread: returns the next token, as yylex
+          // does, after carrying out any errors and tabs before it
+    int Next(YYSTYPE *lval, yyltype *lloc);
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <stdarg.h>
 #include "list.h"
 #include <string.h>
+#include <ostream>
 
 static List<const char*> debugKeys;
 static const int BufferSize = 2048;
@@ -62,21 +63,77 @@ void PrintDebug(const char *key, const char *format, ...)
   va_start(args, format);
   vsprintf(buf, format, args);
   va_end(args);
+  if (OutputBuffer *b = OutputBuffer::Current()) {
+    b->Add(false, std::string("+++ (") + key + "): " + buf + (buf[strlen(buf)-1] != '\n'? "\n" : ""));
+    return;
+  }
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
 
-void ParseCommandLine(int argc, char *argv[])
+thread_local OutputBuffer *OutputBuffer::current = NULL;
+
+void OutputBuffer::Add(bool isError, const std::string &text)
 {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Usage:   -d <debug-key-1> <debug-key-2> ... \n");
+  Piece p = { isError, text };
+  pieces.push_back(p);
+}
+
+int OutputBuffer::Flush(std::ostream &errors)
+{
+  int numErrors = 0;
+  for (size_t i = 0; i < pieces.size(); i++) {
+    if (pieces[i].isError) {
+      fflush(stdout); // as ReportError does before each message
+      errors << pieces[i].text << std::flush;
+      numErrors++;
+    } else
+      fputs(pieces[i].text.c_str(), stdout);
+  }
+  std::vector<Piece>().swap(pieces);
+  return numErrors;
+}
+
+
+const char *ParseCommandLine(int argc, char *argv[], Options *options)
+{
+  const char *file = NULL;
+  int i;
+  *options = Options();
+  for (i = 1; i < argc && strcmp(argv[i], "-d") != 0; i++) {
+    if (strcmp(argv[i], "-fsyntax-only") == 0)
+      options->syntaxOnly = true;
+    else if (strcmp(argv[i], "-fhand-scanner") == 0)
+      options->handScanner = true;
+    else if (strcmp(argv[i], "-fscan-thread") == 0)
+      options->scanThread = true;
+    else if (strcmp(argv[i], "-fscan-chunks") == 0)
+      options->scanChunks = true;
+    else if (strcmp(argv[i], "-fhand-parser") == 0)
+      options->handParser = true;
+    else if (strncmp(argv[i], "-j", 2) == 0) { // -j <n> or -j<n>
+      const char *n = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+      char *end;
+      options->numJobs = strtol(n, &end, 10);
+      if (*end != '\0' || options->numJobs < 1) {
+        printf("dcc: -j needs a number of threads, at least 1\n");
+        exit(2);
+      }
+    } else if (file == NULL) // the other is the input file
+      file = argv[i];
+    else { // anything else must be -d
+      printf("Usage:   [<file>] [-fsyntax-only] [-fhand-scanner] [-fscan-thread] [-fscan-chunks] [-fhand-parser] [-j <n>] [-d <debug-key-1> <debug-key-2> ...] \n"
+             "         -fsyntax-only parses with the hand-written parser, as -fhand-parser does\n");
+      exit(2);
+    }
+  }
+
+  if (options->scanChunks && !options->handScanner) {
+    printf("dcc: -fscan-chunks needs -fhand-scanner, which scans the chunks\n");
     exit(2);
   }
 
-  for (int i = 2; i < argc; i++)
+  for (i++; i < argc; i++)
     SetDebugForKey(argv[i], true);
+  return file;
 }
-
@@ -9,6 +9,9 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <iosfwd>
+#include <string>
+#include <vector>
 
 
 /* Function: Failure()
@@ -72,12 +75,71 @@ bool IsDebugOn(const char *key);
 
 
 
+/* Class: OutputBuffer
+ * Usage: OutputBuffer::Install(&buffer); ... buffer.Flush(std::cerr);
+ * --------------------------------------------------------------------
+ * While a buffer is installed on a thread, what PrintDebug prints there
+ * and the error messages reported there (see errors.cc) are kept in it,
+ * in the order they came, instead of being printed. Flush prints them
+ * just as they would have been, debug output to stdout and messages to
+ * the given stream. Work done on several threads at once can then print
+ * what it would have, in the order it would have, by giving each piece
+ * of work a buffer and flushing them in order.
+ */
+class OutputBuffer
+{
+  private:
+    struct Piece {
+        bool isError;
+        std::string text;
+    };
+    std::vector<Piece> pieces;
+
+    static thread_local OutputBuffer *current;
+
+  public:
+          // The buffer installed on the calling thread, NULL if none
+    static OutputBuffer *Current() { return current; }
+    static void Install(OutputBuffer *b) { current = b; }
+
+    void Add(bool isError, const std::string &text);
+
+          // Prints and empties the buffer, returns the number of error
+          // messages there were in it
+    int Flush(std::ostream &errors);
+};
+
+
+/* Struct: Options
+ * ---------------
+ * How a program is to be compiled, as asked for on the command line.
+ * Each compilation is given its own (see compilation.h).
+ */
+struct Options {
+    bool syntaxOnly;      // -fsyntax-only: only parse, with the hand parser, see Compilation::Run
+    int numJobs;          // -j <n>: threads to check function bodies on
+    bool handScanner;     // -fhand-scanner: scan with hand_scanner.cc
+    bool scanThread;      // -fscan-thread: scan on a thread, see token_ring.h
+    bool scanChunks;      // -fscan-chunks: scan in chunks, see chunked_scan.h;
+                          // only with handScanner, which scans the chunks
+    bool handParser;      // -fhand-parser: parse with hand_parser.cc
+
+    Options() : syntaxOnly(false), numJobs(1), handScanner(false), scanThread(false),
+                scanChunks(false), handParser(false) {}
+};
+
+
 /* Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Reads the command line, which is an optional input file name and the
+ * options, in any order, followed by optional debugging flags:
+ * dcc [<file>] [-fsyntax-only] [-fhand-scanner] [-fscan-thread]
+ *     [-fscan-chunks] [-fhand-parser] [-j <n>] [-d <key-1> ...].
+ * Every argument after -d is a flag to turn on. Fills in *options
+ * (defaults for those not given) and returns the file name, or NULL if
+ * the program is to be read from standard input. Exits with a message
+ * if -fscan-chunks is given without -fhand-scanner.
  */
-void ParseCommandLine(int argc, char *argv[]);
+const char *ParseCommandLine(int argc, char *argv[], Options *options);
      
 #endif
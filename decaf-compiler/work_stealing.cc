@@ -0,0 +1,94 @@
+/* File: work_stealing.cc
+ * ----------------------
+ * Implementation of WorkStealing, see work_stealing.h.
+ */
+
+#include <thread>
+#include "work_stealing.h"
+
+
+void WorkStealing::Run(int numTasks, int numThreads) {
+    if (numThreads > numTasks)
+        numThreads = numTasks;
+    if (numThreads < 1)
+        numThreads = 1;
+    for (int t = 0; t < numThreads; t++) {
+        Share *s = new Share;
+        s->next = (long)numTasks * t / numThreads;
+        s->end = (long)numTasks * (t + 1) / numThreads;
+        shares.push_back(s);
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(&WorkStealing::Work, this, t));
+    Work(0);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    for (size_t i = 0; i < shares.size(); i++)
+        delete shares[i];
+    shares.clear();
+}
+
+void WorkStealing::Work(int thread) {
+    StartThread(thread);
+    int task;
+    while (Take(thread, &task) || (Steal(thread) && Take(thread, &task)))
+        DoTask(task, thread);
+    FinishThread(thread);
+}
+
+/* Function: Take
+ * --------------
+ * Takes the next task from the front of the thread's own share, if it
+ * has one left.
+ */
+bool WorkStealing::Take(int thread, int *task) {
+    Share *s = shares[thread];
+    std::lock_guard<std::mutex> hold(s->lock);
+    if (s->next == s->end)
+        return false;
+    *task = s->next++;
+    return true;
+}
+
+/* Function: Steal
+ * ---------------
+ * Moves the back half of the largest share left (rounded up, so that a
+ * last task can be stolen too) to the thread's own, which is empty.
+ * Returns false once there is nothing left to steal anywhere. The shares
+ * are looked at one at a time, so the largest may have shrunk by the
+ * time it is stolen from; it is only a guess at the best one.
+ */
+bool WorkStealing::Steal(int thread) {
+    for (;;) {
+        int victim = -1, most = 0;
+        for (size_t t = 0; t < shares.size(); t++) {
+            std::lock_guard<std::mutex> hold(shares[t]->lock);
+            int left = shares[t]->end - shares[t]->next;
+            if (left > most) {
+                most = left;
+                victim = t;
+            }
+        }
+        if (victim < 0)
+            return false;
+
+        Share *v = shares[victim], *mine = shares[thread];
+        int first, end;
+        {
+            std::lock_guard<std::mutex> hold(v->lock);
+            int left = v->end - v->next;
+            if (left == 0)
+                continue;               // emptied since, look again
+            first = v->end - (left + 1) / 2;
+            end = v->end;
+            v->end = first;
+        }
+        std::lock_guard<std::mutex> hold(mine->lock);
+        mine->next = first;
+        mine->end = end;
+        return true;
+    }
+}
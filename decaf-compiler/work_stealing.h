@@ -0,0 +1,58 @@
+/* File: work_stealing.h
+ * ---------------------
+ * Runs a numbered set of tasks on several threads at once, sharing them
+ * out by work stealing. Each thread starts with an even share of the
+ * tasks, a run of consecutive numbers, and takes them from the front of
+ * its share one at a time. A thread that runs out steals the back half
+ * of what is left of the largest share, and goes on from there, so that
+ * the threads keep busy until the last task is taken however unevenly
+ * the work is spread over the tasks.
+ *
+ * A subclass says what a task is in DoTask, and sets each thread up in
+ * StartThread and puts it back in FinishThread. The calling thread is
+ * thread 0, and takes tasks like the others; the rest are started by
+ * Run and finished before it returns.
+ *
+ * Sample usage:
+ *
+ *       class Squares : public WorkStealing {
+ *           void DoTask(int task, int thread) { result[task] = task * task; }
+ *       } squares;
+ *       squares.Run(1000, 4);
+ */
+
+#ifndef _H_work_stealing
+#define _H_work_stealing
+
+#include <mutex>
+#include <vector>
+
+class WorkStealing
+{
+  private:
+    struct Share {
+        std::mutex lock;
+        int next, end;              // tasks not yet taken, [next, end)
+    };
+
+    std::vector<Share*> shares;     // one per thread
+
+    bool Take(int thread, int *task);
+    bool Steal(int thread);
+    void Work(int thread);
+
+  protected:
+    virtual void StartThread(int thread) {}
+    virtual void DoTask(int task, int thread) = 0;
+    virtual void FinishThread(int thread) {}
+
+  public:
+    virtual ~WorkStealing() {}
+
+          // Calls DoTask once for each task from 0 to numTasks-1, on
+          // numThreads threads (but no more than there are tasks), in
+          // no particular order, and returns when all are done
+    void Run(int numTasks, int numThreads);
+};
+
+#endif